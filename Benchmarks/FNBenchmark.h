@@ -0,0 +1,57 @@
+//
+// FNBenchmark.h
+//
+// Copyright (c) 2013 Fauna, Inc.
+//
+// Licensed under the Mozilla Public License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain a
+// copy of the License at
+//
+// http://mozilla.org/MPL/2.0/
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+/*!
+ Runs a benchmark and prints its results as one JSON object per line: the benchmark name and parameter, ops/sec, p50 and p99 latency per iteration in microseconds, and heap allocations per op where the platform lets us count them (null otherwise).
+ */
+@interface FNBenchmark : NSObject
+
+/*!
+ Only benchmarks whose name contains the filter are run. Nil runs everything.
+ */
++ (void)setFilter:(NSString *)filter;
+
+/*!
+ Divides iteration counts by ten, for smoke testing.
+ */
++ (void)setQuick:(BOOL)quick;
+
++ (BOOL)isQuick;
+
+/*!
+ Times each call of the block. Each call counts as opsPerIteration ops.
+ */
++ (void)run:(NSString *)name param:(NSUInteger)param iterations:(NSUInteger)iterations opsPerIteration:(NSUInteger)ops block:(void (^)(void))block;
+
+/*!
+ Like run:param:iterations:opsPerIteration:block:, but the block times itself, returning the latency of the iteration in seconds. Use it to exclude setup from the measurement.
+ */
++ (void)run:(NSString *)name param:(NSUInteger)param iterations:(NSUInteger)iterations opsPerIteration:(NSUInteger)ops timedBlock:(NSTimeInterval (^)(void))block;
+
+/*!
+ Prints a single measured value that is not a rate, such as a size, as a JSON object with the benchmark name, parameter, value and unit. Subject to the filter like run:.
+ */
++ (void)report:(NSString *)name param:(NSUInteger)param value:(double)value unit:(NSString *)unit;
+
+@end
+
+/*!
+ Returns a monotonic timestamp in seconds.
+ */
+NSTimeInterval FNBenchmarkNow(void);
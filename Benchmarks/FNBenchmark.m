@@ -0,0 +1,147 @@
+//
+// FNBenchmark.m
+//
+// Copyright (c) 2013 Fauna, Inc.
+//
+// Licensed under the Mozilla Public License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain a
+// copy of the License at
+//
+// http://mozilla.org/MPL/2.0/
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+//
+
+#import <stdio.h>
+#import <stdlib.h>
+#import <time.h>
+#import "FNBenchmark.h"
+
+#if defined(__GLIBC__)
+
+// Count heap allocations by interposing the allocator. Symbols in the
+// executable take precedence over libc's, so this also sees allocations
+// made inside Foundation and the runtime.
+
+#define FNCountsAllocations 1
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static uint64_t volatile FNAllocations;
+
+void *malloc(size_t size) {
+  __sync_add_and_fetch(&FNAllocations, 1);
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+  __sync_add_and_fetch(&FNAllocations, 1);
+  return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+  if (!ptr) __sync_add_and_fetch(&FNAllocations, 1);
+  return __libc_realloc(ptr, size);
+}
+
+#else
+
+#define FNCountsAllocations 0
+
+static uint64_t volatile FNAllocations;
+
+#endif
+
+static NSString *FNBenchmarkFilter;
+static BOOL FNBenchmarkQuick;
+
+NSTimeInterval FNBenchmarkNow(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int CompareLatencies(const void *a, const void *b) {
+  NSTimeInterval x = *(const NSTimeInterval *)a, y = *(const NSTimeInterval *)b;
+  return x < y ? -1 : x > y ? 1 : 0;
+}
+
+static NSTimeInterval Percentile(NSTimeInterval *sorted, NSUInteger count, double p) {
+  NSUInteger idx = (NSUInteger)(p * (count - 1) + 0.5);
+  return sorted[MIN(idx, count - 1)];
+}
+
+@implementation FNBenchmark
+
++ (void)setFilter:(NSString *)filter {
+  FNBenchmarkFilter = filter;
+}
+
++ (void)setQuick:(BOOL)quick {
+  FNBenchmarkQuick = quick;
+}
+
++ (BOOL)isQuick {
+  return FNBenchmarkQuick;
+}
+
++ (void)run:(NSString *)name param:(NSUInteger)param iterations:(NSUInteger)iterations opsPerIteration:(NSUInteger)ops block:(void (^)(void))block {
+  [self run:name param:param iterations:iterations opsPerIteration:ops timedBlock:^{
+    NSTimeInterval start = FNBenchmarkNow();
+    block();
+    return FNBenchmarkNow() - start;
+  }];
+}
+
++ (void)run:(NSString *)name param:(NSUInteger)param iterations:(NSUInteger)iterations opsPerIteration:(NSUInteger)ops timedBlock:(NSTimeInterval (^)(void))block {
+  if (FNBenchmarkFilter && [name rangeOfString:FNBenchmarkFilter].location == NSNotFound) return;
+
+  if (FNBenchmarkQuick) iterations = MAX(iterations / 10, 1);
+
+  for (NSUInteger i = 0; i < MAX(iterations / 10, 1); i++) {
+    @autoreleasepool { block(); }
+  }
+
+  NSTimeInterval *latencies = malloc(sizeof(NSTimeInterval) * iterations);
+  NSTimeInterval total = 0;
+  uint64_t allocations = 0;
+
+  for (NSUInteger i = 0; i < iterations; i++) {
+    @autoreleasepool {
+      uint64_t before = FNAllocations;
+      latencies[i] = block();
+      allocations += FNAllocations - before;
+      total += latencies[i];
+    }
+  }
+
+  qsort(latencies, iterations, sizeof(NSTimeInterval), CompareLatencies);
+
+  double totalOps = (double)iterations * ops;
+  NSString *allocsPerOp = FNCountsAllocations ? [NSString stringWithFormat:@"%.2f", allocations / totalOps] : @"null";
+
+  printf("{\"benchmark\": \"%s\", \"param\": %lu, \"iterations\": %lu, \"ops\": %.0f, \"ops_per_sec\": %.1f, \"p50_us\": %.3f, \"p99_us\": %.3f, \"allocs_per_op\": %s}\n",
+         name.UTF8String, (unsigned long)param, (unsigned long)iterations, totalOps,
+         total > 0 ? totalOps / total : 0,
+         Percentile(latencies, iterations, 0.5) * 1e6,
+         Percentile(latencies, iterations, 0.99) * 1e6,
+         allocsPerOp.UTF8String);
+  fflush(stdout);
+
+  free(latencies);
+}
+
++ (void)report:(NSString *)name param:(NSUInteger)param value:(double)value unit:(NSString *)unit {
+  if (FNBenchmarkFilter && [name rangeOfString:FNBenchmarkFilter].location == NSNotFound) return;
+
+  printf("{\"benchmark\": \"%s\", \"param\": %lu, \"value\": %.1f, \"unit\": \"%s\"}\n",
+         name.UTF8String, (unsigned long)param, value, unit.UTF8String);
+  fflush(stdout);
+}
+
+@end
@@ -0,0 +1,178 @@
+//
+// FNCacheBenchmarks.m
+//
+// Copyright (c) 2013 Fauna, Inc.
+//
+// Licensed under the Mozilla Public License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain a
+// copy of the License at
+//
+// http://mozilla.org/MPL/2.0/
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+//
+
+#import <unistd.h>
+#import "FNCacheBenchmarks.h"
+#import "FNBenchmark.h"
+#import "FNFuture.h"
+#import "FNSQLiteConnection.h"
+#import "FNSQLiteCache.h"
+#import "FNCacheCodec.h"
+
+#define ResourceCount 1000
+
+static NSString * TemporaryDatabasePath(NSString *name) {
+  NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSString stringWithFormat:@"fnbench-%@-%d.db", name, getpid()]];
+  [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+  return path;
+}
+
+static NSDictionary * Resource(NSUInteger i) {
+  return @{@"ref": [NSString stringWithFormat:@"instances/%lu", (unsigned long)i],
+           @"class": @"classes/message",
+           @"unique_id": [NSString stringWithFormat:@"message-%lu", (unsigned long)i],
+           @"data": @{@"body": @"Lorem ipsum dolor sit amet, consectetur adipiscing elit."},
+           @"ts": @(i)};
+}
+
+// Mirrors the statements FNSQLiteCache runs for setObject: and objectForPath:.
+static void BenchmarkConnection(NSUInteger statementCacheSize) {
+  NSString *path = TemporaryDatabasePath(@"connection");
+  FNSQLiteConnection *db = [[FNSQLiteConnection alloc] initWithSQLitePath:path];
+  db.statementCacheSize = statementCacheSize;
+
+  [db execute:@"CREATE TABLE resources (id INTEGER PRIMARY KEY NOT NULL, data BLOB, timestamp INTEGER NOT NULL, deleted INTEGER NOT NULL DEFAULT 0)" error:NULL];
+  [db execute:@"CREATE TABLE resource_aliases (alias TEXT PRIMARY KEY NOT NULL, resource_id INTEGER NOT NULL, derived INTEGER NOT NULL)" error:NULL];
+
+  NSData *data = [NSKeyedArchiver archivedDataWithRootObject:Resource(0)];
+  NSUInteger __block n = 0;
+
+  [FNBenchmark run:@"cache.connection_write" param:statementCacheSize iterations:5000 opsPerIteration:1 block:^{
+    NSString *ref = [NSString stringWithFormat:@"instances/%lu", (unsigned long)(n++ % ResourceCount)];
+
+    [db withTransaction:^{
+      NSArray *prev = [db select:@"SELECT resource_id FROM resource_aliases WHERE alias = ?" parameters:@[ref] error:NULL];
+      NSNumber *resID = prev.count > 0 ? prev[0][0] : nil;
+
+      if (resID) {
+        [db execute:@"DELETE FROM resource_aliases WHERE resource_id = ? AND derived = 1" parameters:@[resID] error:NULL];
+        [db execute:@"UPDATE resources SET data = ?, timestamp = ?, deleted = 0 WHERE id = ?" parameters:@[data, @(n), resID] error:NULL];
+      } else {
+        [db execute:@"INSERT INTO resources (data, timestamp) VALUES (?, ?)" parameters:@[data, @(n)] error:NULL];
+        resID = @(db.lastRowID);
+      }
+
+      [db execute:@"REPLACE INTO resource_aliases (alias, resource_id, derived) VALUES (?, ?, 0)" parameters:@[[ref stringByAppendingString:@"/extra"], resID] error:NULL];
+      [db execute:@"REPLACE INTO resource_aliases (alias, resource_id, derived) VALUES (?, ?, 1)" parameters:@[ref, resID] error:NULL];
+      return YES;
+    }];
+  }];
+
+  [FNBenchmark run:@"cache.connection_read" param:statementCacheSize iterations:50000 opsPerIteration:1 block:^{
+    NSString *ref = [NSString stringWithFormat:@"instances/%lu", (unsigned long)(n++ % ResourceCount)];
+
+    [db select:@"SELECT r.data, r.deleted FROM resources AS r JOIN resource_aliases as a on r.id = a.resource_id WHERE a.alias = ? AND r.timestamp >= ?"
+    parameters:@[ref, @0]
+         error:NULL];
+  }];
+
+  [db close];
+  [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+}
+
+static void BenchmarkSQLiteCache(void) {
+  NSString *path = TemporaryDatabasePath(@"cache");
+  FNSQLiteCache *cache = [[FNSQLiteCache alloc] initWithSQLitePath:path maxSize:100 * 1024 * 1024];
+  NSUInteger __block n = 0;
+
+  [FNBenchmark run:@"cache.sqlite_write" param:0 iterations:5000 opsPerIteration:1 block:^{
+    NSDictionary *resource = Resource(n++ % ResourceCount);
+    [[cache setObject:resource extraPaths:@[[resource[@"ref"] stringByAppendingString:@"/extra"]] timestamp:(FNTimestamp)n] wait];
+  }];
+
+  [FNBenchmark run:@"cache.sqlite_read" param:0 iterations:20000 opsPerIteration:1 block:^{
+    [[cache objectForPath:[NSString stringWithFormat:@"instances/%lu", (unsigned long)(n++ % ResourceCount)] after:0] wait];
+  }];
+
+  [cache close];
+  [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+}
+
+// Encode and decode cost and encoded size per resource, by codec id.
+static void BenchmarkCodec(FNCacheCodecID codecID) {
+  id<FNCacheCodec> codec = FNCacheCodecWithID(codecID);
+  NSMutableArray *resources = [NSMutableArray arrayWithCapacity:ResourceCount];
+  NSMutableArray *encoded = [NSMutableArray arrayWithCapacity:ResourceCount];
+  double bytes = 0;
+
+  for (NSUInteger i = 0; i < ResourceCount; i++) {
+    NSDictionary *resource = Resource(i);
+    NSData *data = [codec encode:resource];
+
+    [resources addObject:resource];
+    [encoded addObject:data];
+    bytes += data.length;
+  }
+
+  [FNBenchmark report:@"cache.codec_size" param:codecID value:bytes / ResourceCount unit:@"bytes_per_resource"];
+
+  NSUInteger __block n = 0;
+
+  [FNBenchmark run:@"cache.codec_encode" param:codecID iterations:20000 opsPerIteration:1 block:^{
+    [codec encode:resources[n++ % ResourceCount]];
+  }];
+
+  [FNBenchmark run:@"cache.codec_decode" param:codecID iterations:20000 opsPerIteration:1 block:^{
+    [codec decode:encoded[n++ % ResourceCount]];
+  }];
+}
+
+// Read latency while another thread writes continuously. With 0 readers,
+// reads queue behind writes on the single connection.
+static void BenchmarkMixedWorkload(NSUInteger readers) {
+  NSString *path = TemporaryDatabasePath(@"mixed");
+  FNSQLiteCache *cache = [[FNSQLiteCache alloc] initWithSQLitePath:path maxSize:100 * 1024 * 1024 readers:readers];
+
+  for (NSUInteger i = 0; i < ResourceCount; i++) {
+    [cache setObject:Resource(i) extraPaths:@[] timestamp:(FNTimestamp)i];
+  }
+  [[cache setObject:Resource(0) extraPaths:@[] timestamp:0] wait];
+
+  BOOL volatile __block writing = YES;
+  dispatch_semaphore_t stopped = dispatch_semaphore_create(0);
+
+  dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+    for (NSUInteger i = 0; writing; i++) {
+      [[cache setObject:Resource(i % ResourceCount) extraPaths:@[] timestamp:(FNTimestamp)i] wait];
+    }
+    dispatch_semaphore_signal(stopped);
+  });
+
+  NSUInteger __block n = 0;
+
+  [FNBenchmark run:@"cache.mixed_read_latency" param:readers iterations:5000 opsPerIteration:1 block:^{
+    [[cache objectForPath:[NSString stringWithFormat:@"instances/%lu", (unsigned long)(n++ % ResourceCount)] after:0] wait];
+  }];
+
+  writing = NO;
+  dispatch_semaphore_wait(stopped, DISPATCH_TIME_FOREVER);
+
+  [cache close];
+  [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+}
+
+void FNRunCacheBenchmarks(void) {
+  BenchmarkConnection(0);
+  BenchmarkConnection(32);
+  BenchmarkCodec(FNCacheCodecKeyedArchiver);
+  BenchmarkCodec(FNCacheCodecBinary);
+  BenchmarkCodec(FNCacheCodecJSON);
+  BenchmarkSQLiteCache();
+  BenchmarkMixedWorkload(0);
+  BenchmarkMixedWorkload(2);
+  BenchmarkMixedWorkload(4);
+}
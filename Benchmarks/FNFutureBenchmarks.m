@@ -0,0 +1,112 @@
+//
+// FNFutureBenchmarks.m
+//
+// Copyright (c) 2013 Fauna, Inc.
+//
+// Licensed under the Mozilla Public License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain a
+// copy of the License at
+//
+// http://mozilla.org/MPL/2.0/
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+//
+
+#import <unistd.h>
+#import "FNFutureBenchmarks.h"
+#import "FNBenchmark.h"
+#import "FNMutableFuture.h"
+
+static void BenchmarkMapChain(void) {
+  for (NSUInteger depth = 1; depth <= 10000; depth *= 10) {
+    [FNBenchmark run:@"future.map_chain" param:depth iterations:MAX(100000 / depth, 20) opsPerIteration:depth timedBlock:^{
+      FNMutableFuture *source = [FNMutableFuture new];
+      FNFuture *future = source;
+
+      for (NSUInteger i = 0; i < depth; i++) {
+        future = [future map:^(NSNumber *n) { return @(n.integerValue + 1); }];
+      }
+
+      NSTimeInterval start = FNBenchmarkNow();
+      [source update:@0];
+      [future wait];
+      return FNBenchmarkNow() - start;
+    }];
+  }
+}
+
+static void BenchmarkSequenceWidth(void) {
+  for (NSUInteger width = 1; width <= 10000; width *= 10) {
+    [FNBenchmark run:@"future.sequence_width" param:width iterations:MAX(100000 / width, 20) opsPerIteration:width block:^{
+      NSMutableArray *inputs = [NSMutableArray arrayWithCapacity:width];
+      for (NSUInteger i = 0; i < width; i++) [inputs addObject:[FNMutableFuture new]];
+
+      FNFuture *sequence = FNFutureSequence(inputs);
+
+      dispatch_apply(width, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+        [inputs[i] update:@(i)];
+      });
+
+      [sequence wait];
+    }];
+  }
+}
+
+static void BenchmarkOnCompletionContention(void) {
+  NSUInteger perThread = 1000;
+
+  for (NSUInteger threads = 1; threads <= 16; threads *= 2) {
+    [FNBenchmark run:@"future.on_completion_contention" param:threads iterations:200 opsPerIteration:threads * perThread block:^{
+      FNMutableFuture *future = [FNMutableFuture new];
+      void (^callback)(FNFuture *) = ^(FNFuture *result) { };
+
+      dispatch_apply(threads, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t t) {
+        for (NSUInteger i = 0; i < perThread; i++) {
+          [future onCompletion:callback on:[FNInlineExecutor sharedExecutor]];
+        }
+      });
+
+      [future update:nil];
+    }];
+  }
+}
+
+static void BenchmarkWaitLatency(void) {
+  dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+
+  // 0: the future is already complete; 1: another thread completes it while
+  // we are parked.
+  [FNBenchmark run:@"future.wait_latency" param:0 iterations:100000 opsPerIteration:1 timedBlock:^{
+    FNMutableFuture *future = [FNMutableFuture new];
+    [future update:nil];
+
+    NSTimeInterval start = FNBenchmarkNow();
+    [future wait];
+    return FNBenchmarkNow() - start;
+  }];
+
+  [FNBenchmark run:@"future.wait_latency" param:1 iterations:10000 opsPerIteration:1 timedBlock:^{
+    FNMutableFuture *future = [FNMutableFuture new];
+    NSTimeInterval __block completedAt;
+
+    dispatch_async(queue, ^{
+      usleep(50);
+      completedAt = FNBenchmarkNow();
+      [future update:nil];
+    });
+
+    [future wait];
+
+    return FNBenchmarkNow() - completedAt;
+  }];
+}
+
+void FNRunFutureBenchmarks(void) {
+  BenchmarkMapChain();
+  BenchmarkSequenceWidth();
+  BenchmarkOnCompletionContention();
+  BenchmarkWaitLatency();
+}
@@ -0,0 +1,41 @@
+//
+// main.m
+//
+// Copyright (c) 2013 Fauna, Inc.
+//
+// Licensed under the Mozilla Public License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain a
+// copy of the License at
+//
+// http://mozilla.org/MPL/2.0/
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+#import "FNBenchmark.h"
+#import "FNFutureBenchmarks.h"
+#import "FNCacheBenchmarks.h"
+
+int main(int argc, const char *argv[]) {
+  @autoreleasepool {
+    for (int i = 1; i < argc; i++) {
+      if (strcmp(argv[i], "--quick") == 0) {
+        [FNBenchmark setQuick:YES];
+      } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+        [FNBenchmark setFilter:@(argv[++i])];
+      } else {
+        fprintf(stderr, "usage: %s [--quick] [--filter NAME]\n", argv[0]);
+        return 1;
+      }
+    }
+
+    FNRunFutureBenchmarks();
+    FNRunCacheBenchmarks();
+  }
+
+  return 0;
+}
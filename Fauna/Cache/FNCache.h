@@ -26,12 +26,44 @@ NSError * CacheWriteError();
 
 @class FNFuture;
 
+/*!
+ A cached value along with the time it was written.
+ */
+@interface FNCachedObject : NSObject
+
+@property (nonatomic, readonly) id value;
+@property (nonatomic, readonly) FNTimestamp timestamp;
+
+- (id)initWithValue:(id)value timestamp:(FNTimestamp)timestamp;
+
+@end
+
 @interface FNCache : NSObject
 
 - (FNFuture *)setObject:(NSDictionary *)value extraPaths:(NSArray *)paths timestamp:(FNTimestamp)timestamp;
 
+/*!
+ Stores a batch of resources, with no extra paths, as one write.
+ */
+- (FNFuture *)setObjects:(NSArray *)values timestamp:(FNTimestamp)timestamp;
+
 - (FNFuture *)removeObjectForPath:(NSString *)path timestamp:(FNTimestamp)timestamp;
 
 - (FNFuture *)objectForPath:(NSString *)path after:(FNTimestamp)after;
 
+/*!
+ Like objectForPath:after:, but returns an FNCachedObject, or nil on a miss. Caches that do not keep write times report after as the timestamp.
+ */
+- (FNFuture *)cachedObjectForPath:(NSString *)path after:(FNTimestamp)after;
+
+/*!
+ Looks up several paths at once. Returns a dictionary from path to value or FNCacheTombstone, without entries for paths that missed.
+ */
+- (FNFuture *)objectsForPaths:(NSArray *)paths after:(FNTimestamp)after;
+
+/*!
+ Releases the cache's underlying storage. Operations after closing fail. Does nothing by default.
+ */
+- (void)close;
+
 @end
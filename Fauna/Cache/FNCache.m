@@ -28,12 +28,34 @@ NSError * CacheWriteError() {
   return [NSError errorWithDomain:@"org.fauna.FNCache" code:2 userInfo:@{@"msg": @"Cache write failed"}];
 }
 
+@implementation FNCachedObject
+
+- (id)initWithValue:(id)value timestamp:(FNTimestamp)timestamp {
+  if (self = [super init]) {
+    _value = value;
+    _timestamp = timestamp;
+  }
+  return self;
+}
+
+@end
+
 @implementation FNCache
 
 - (FNFuture *)setObject:(NSDictionary *)value extraPaths:(NSArray *)paths timestamp:(FNTimestamp)timestamp {
   @throw @"not implemented";
 }
 
+- (FNFuture *)setObjects:(NSArray *)values timestamp:(FNTimestamp)timestamp {
+  NSMutableArray *writes = [NSMutableArray arrayWithCapacity:values.count];
+
+  for (NSDictionary *value in values) {
+    [writes addObject:[self setObject:value extraPaths:@[] timestamp:timestamp]];
+  }
+
+  return FNFutureJoin(writes);
+}
+
 - (FNFuture *)removeObjectForPath:(NSString *)path timestamp:(FNTimestamp)timestamp {
   @throw @"not implemented";
 }
@@ -42,5 +64,31 @@ NSError * CacheWriteError() {
   @throw @"not implemented";
 }
 
+- (FNFuture *)objectsForPaths:(NSArray *)paths after:(FNTimestamp)after {
+  NSMutableArray *reads = [NSMutableArray arrayWithCapacity:paths.count];
+
+  for (NSString *path in paths) {
+    [reads addObject:[self objectForPath:path after:after]];
+  }
+
+  return [FNFutureSequence(reads) map:^id(NSArray *values) {
+    NSMutableDictionary *rv = [NSMutableDictionary dictionaryWithCapacity:paths.count];
+
+    for (NSUInteger i = 0; i < paths.count; i++) {
+      if (values[i] != [NSNull null]) rv[paths[i]] = values[i];
+    }
+
+    return rv;
+  }];
+}
+
+- (FNFuture *)cachedObjectForPath:(NSString *)path after:(FNTimestamp)after {
+  return [[self objectForPath:path after:after] map:^id(id value) {
+    return value ? [[FNCachedObject alloc] initWithValue:value timestamp:after] : nil;
+  }];
+}
+
+- (void)close { }
+
 @end
 
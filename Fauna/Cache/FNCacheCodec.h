@@ -0,0 +1,66 @@
+//
+// FNCacheCodec.h
+//
+// Copyright (c) 2013 Fauna, Inc.
+//
+// Licensed under the Mozilla Public License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain a
+// copy of the License at
+//
+// http://mozilla.org/MPL/2.0/
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+typedef enum {
+  FNCacheCodecKeyedArchiver = 0,
+  FNCacheCodecBinary = 1,
+  FNCacheCodecJSON = 2
+} FNCacheCodecID;
+
+/*!
+ Converts cached resources to and from the bytes stored for them. Each stored value records the identifier of the codec that wrote it, so a cache can change codecs without invalidating what it already holds.
+ */
+@protocol FNCacheCodec <NSObject>
+
+- (FNCacheCodecID)identifier;
+
+/*!
+ Returns nil if the value contains something the codec cannot represent.
+ */
+- (NSData *)encode:(NSDictionary *)value;
+
+/*!
+ Returns nil if the data is malformed.
+ */
+- (NSDictionary *)decode:(NSData *)data;
+
+@end
+
+/*!
+ Returns the built-in codec with the given identifier, or nil if there is none.
+ */
+id<FNCacheCodec> FNCacheCodecWithID(FNCacheCodecID identifier);
+
+/*!
+ NSKeyedArchiver archives. Handles any NSCoding value, but is large and slow to decode. Used by caches written before codecs were introduced.
+ */
+@interface FNKeyedArchiverCodec : NSObject <FNCacheCodec>
+@end
+
+/*!
+ A compact binary encoding of JSON values. Every string, key or value, is written once to a table at the front and referred to by index, so repeated keys and class names cost a byte or two each.
+ */
+@interface FNBinaryCodec : NSObject <FNCacheCodec>
+@end
+
+/*!
+ JSON text, as sent by the server.
+ */
+@interface FNJSONCodec : NSObject <FNCacheCodec>
+@end
@@ -0,0 +1,351 @@
+//
+// FNCacheCodec.m
+//
+// Copyright (c) 2013 Fauna, Inc.
+//
+// Licensed under the Mozilla Public License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain a
+// copy of the License at
+//
+// http://mozilla.org/MPL/2.0/
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+//
+
+#import "FNCacheCodec.h"
+
+#define BinaryCodecVersion 1
+#define BinaryCodecMaxDepth 256
+
+// Value tags in the binary encoding.
+enum {
+  BinaryNull = 0,
+  BinaryFalse = 1,
+  BinaryTrue = 2,
+  BinaryInteger = 3,
+  BinaryDouble = 4,
+  BinaryString = 5,
+  BinaryArray = 6,
+  BinaryObject = 7
+};
+
+id<FNCacheCodec> FNCacheCodecWithID(FNCacheCodecID identifier) {
+  static NSArray *codecs;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    codecs = @[[FNKeyedArchiverCodec new], [FNBinaryCodec new], [FNJSONCodec new]];
+  });
+
+  return identifier >= 0 && (NSUInteger)identifier < codecs.count ? codecs[identifier] : nil;
+}
+
+@implementation FNKeyedArchiverCodec
+
+- (FNCacheCodecID)identifier {
+  return FNCacheCodecKeyedArchiver;
+}
+
+- (NSData *)encode:(NSDictionary *)value {
+  return [NSKeyedArchiver archivedDataWithRootObject:value];
+}
+
+- (NSDictionary *)decode:(NSData *)data {
+  @try {
+    id rv = [NSKeyedUnarchiver unarchiveObjectWithData:data];
+    return [rv isKindOfClass:[NSDictionary class]] ? rv : nil;
+  } @catch (NSException *exception) {
+    return nil;
+  }
+}
+
+@end
+
+#pragma mark Binary encoding
+
+static void WriteVarint(NSMutableData *out, uint64_t v) {
+  uint8_t buf[10];
+  int len = 0;
+
+  do {
+    buf[len] = v & 0x7f;
+    v >>= 7;
+    if (v) buf[len] |= 0x80;
+    len++;
+  } while (v);
+
+  [out appendBytes:buf length:len];
+}
+
+static void WriteTag(NSMutableData *out, uint8_t tag) {
+  [out appendBytes:&tag length:1];
+}
+
+static BOOL IsBoolean(NSNumber *number) {
+  const char *type = number.objCType;
+  return (type[0] == 'c' || type[0] == 'B') && type[1] == '\0';
+}
+
+static BOOL IsFloatingPoint(NSNumber *number) {
+  const char *type = number.objCType;
+  return (type[0] == 'f' || type[0] == 'd') && type[1] == '\0';
+}
+
+@interface FNBinaryEncoder : NSObject
+
+@property (nonatomic, readonly) NSMutableData *body;
+@property (nonatomic, readonly) NSMutableArray *strings;
+@property (nonatomic, readonly) NSMutableDictionary *indexes;
+
+@end
+
+@implementation FNBinaryEncoder
+
+- (id)init {
+  if (self = [super init]) {
+    _body = [NSMutableData new];
+    _strings = [NSMutableArray new];
+    _indexes = [NSMutableDictionary new];
+  }
+  return self;
+}
+
+- (void)writeString:(NSString *)string {
+  NSNumber *index = self.indexes[string];
+
+  if (!index) {
+    index = @(self.strings.count);
+    self.indexes[string] = index;
+    [self.strings addObject:string];
+  }
+
+  WriteVarint(self.body, index.unsignedLongLongValue);
+}
+
+- (BOOL)writeValue:(id)value depth:(NSUInteger)depth {
+  if (depth > BinaryCodecMaxDepth) return NO;
+
+  if ([value isKindOfClass:[NSString class]]) {
+    WriteTag(self.body, BinaryString);
+    [self writeString:value];
+  } else if ([value isKindOfClass:[NSNumber class]]) {
+    NSNumber *number = value;
+
+    if (IsBoolean(number)) {
+      WriteTag(self.body, number.boolValue ? BinaryTrue : BinaryFalse);
+    } else if (IsFloatingPoint(number)) {
+      double d = number.doubleValue;
+      uint64_t bits;
+      uint8_t buf[8];
+
+      memcpy(&bits, &d, sizeof(bits));
+      for (int i = 0; i < 8; i++) buf[i] = (bits >> (i * 8)) & 0xff;
+
+      WriteTag(self.body, BinaryDouble);
+      [self.body appendBytes:buf length:8];
+    } else {
+      int64_t i = number.longLongValue;
+
+      WriteTag(self.body, BinaryInteger);
+      WriteVarint(self.body, ((uint64_t)i << 1) ^ (uint64_t)(i >> 63));
+    }
+  } else if ([value isKindOfClass:[NSDictionary class]]) {
+    NSDictionary *dict = value;
+
+    WriteTag(self.body, BinaryObject);
+    WriteVarint(self.body, dict.count);
+
+    for (id key in dict) {
+      if (![key isKindOfClass:[NSString class]]) return NO;
+      [self writeString:key];
+      if (![self writeValue:dict[key] depth:depth + 1]) return NO;
+    }
+  } else if ([value isKindOfClass:[NSArray class]]) {
+    NSArray *array = value;
+
+    WriteTag(self.body, BinaryArray);
+    WriteVarint(self.body, array.count);
+
+    for (id elem in array) {
+      if (![self writeValue:elem depth:depth + 1]) return NO;
+    }
+  } else if (value == [NSNull null]) {
+    WriteTag(self.body, BinaryNull);
+  } else {
+    return NO;
+  }
+
+  return YES;
+}
+
+// Version byte, string table, then the root value.
+- (NSData *)data {
+  NSMutableData *rv = [NSMutableData dataWithCapacity:self.body.length + self.strings.count * 8 + 4];
+
+  WriteTag(rv, BinaryCodecVersion);
+  WriteVarint(rv, self.strings.count);
+
+  for (NSString *string in self.strings) {
+    NSData *utf8 = [string dataUsingEncoding:NSUTF8StringEncoding];
+    WriteVarint(rv, utf8.length);
+    [rv appendData:utf8];
+  }
+
+  [rv appendData:self.body];
+
+  return rv;
+}
+
+@end
+
+#pragma mark Binary decoding
+
+typedef struct BinaryReader {
+  const uint8_t *pos;
+  const uint8_t *end;
+  __unsafe_unretained NSArray *strings;
+} BinaryReader;
+
+static BOOL ReadVarint(BinaryReader *r, uint64_t *v) {
+  uint64_t rv = 0;
+
+  for (int shift = 0; shift < 64 && r->pos < r->end; shift += 7) {
+    uint8_t b = *r->pos++;
+    rv |= (uint64_t)(b & 0x7f) << shift;
+
+    if (!(b & 0x80)) {
+      *v = rv;
+      return YES;
+    }
+  }
+
+  return NO;
+}
+
+static NSString * ReadString(BinaryReader *r) {
+  uint64_t index;
+  if (!ReadVarint(r, &index) || index >= r->strings.count) return nil;
+  return r->strings[(NSUInteger)index];
+}
+
+static id ReadValue(BinaryReader *r, NSUInteger depth) {
+  if (depth > BinaryCodecMaxDepth || r->pos >= r->end) return nil;
+
+  uint8_t tag = *r->pos++;
+  uint64_t n;
+
+  switch (tag) {
+    case BinaryNull:
+      return [NSNull null];
+    case BinaryFalse:
+      return @NO;
+    case BinaryTrue:
+      return @YES;
+    case BinaryInteger:
+      if (!ReadVarint(r, &n)) return nil;
+      return @((int64_t)(n >> 1) ^ -(int64_t)(n & 1));
+    case BinaryDouble: {
+      if (r->end - r->pos < 8) return nil;
+
+      uint64_t bits = 0;
+      double d;
+
+      for (int i = 0; i < 8; i++) bits |= (uint64_t)r->pos[i] << (i * 8);
+      r->pos += 8;
+      memcpy(&d, &bits, sizeof(d));
+
+      return @(d);
+    }
+    case BinaryString:
+      return ReadString(r);
+    case BinaryArray: {
+      // Every element takes at least a byte, which bounds bogus counts.
+      if (!ReadVarint(r, &n) || n > (uint64_t)(r->end - r->pos)) return nil;
+
+      NSMutableArray *array = [NSMutableArray arrayWithCapacity:(NSUInteger)n];
+
+      for (uint64_t i = 0; i < n; i++) {
+        id elem = ReadValue(r, depth + 1);
+        if (!elem) return nil;
+        [array addObject:elem];
+      }
+
+      return array;
+    }
+    case BinaryObject: {
+      if (!ReadVarint(r, &n) || n > (uint64_t)(r->end - r->pos)) return nil;
+
+      NSMutableDictionary *dict = [NSMutableDictionary dictionaryWithCapacity:(NSUInteger)n];
+
+      for (uint64_t i = 0; i < n; i++) {
+        NSString *key = ReadString(r);
+        id elem = key ? ReadValue(r, depth + 1) : nil;
+        if (!elem) return nil;
+        dict[key] = elem;
+      }
+
+      return dict;
+    }
+    default:
+      return nil;
+  }
+}
+
+@implementation FNBinaryCodec
+
+- (FNCacheCodecID)identifier {
+  return FNCacheCodecBinary;
+}
+
+- (NSData *)encode:(NSDictionary *)value {
+  FNBinaryEncoder *encoder = [FNBinaryEncoder new];
+  return [encoder writeValue:value depth:0] ? encoder.data : nil;
+}
+
+- (NSDictionary *)decode:(NSData *)data {
+  BinaryReader r = { data.bytes, (const uint8_t *)data.bytes + data.length, nil };
+  uint64_t count;
+
+  if (r.pos >= r.end || *r.pos++ != BinaryCodecVersion) return nil;
+  if (!ReadVarint(&r, &count) || count > (uint64_t)(r.end - r.pos)) return nil;
+
+  NSMutableArray *strings = [NSMutableArray arrayWithCapacity:(NSUInteger)count];
+
+  for (uint64_t i = 0; i < count; i++) {
+    uint64_t len;
+    if (!ReadVarint(&r, &len) || len > (uint64_t)(r.end - r.pos)) return nil;
+
+    NSString *string = [[NSString alloc] initWithBytes:r.pos length:(NSUInteger)len encoding:NSUTF8StringEncoding];
+    if (!string) return nil;
+
+    [strings addObject:string];
+    r.pos += len;
+  }
+
+  r.strings = strings;
+
+  id rv = ReadValue(&r, 0);
+  return [rv isKindOfClass:[NSDictionary class]] && r.pos == r.end ? rv : nil;
+}
+
+@end
+
+@implementation FNJSONCodec
+
+- (FNCacheCodecID)identifier {
+  return FNCacheCodecJSON;
+}
+
+- (NSData *)encode:(NSDictionary *)value {
+  if (![NSJSONSerialization isValidJSONObject:value]) return nil;
+  return [NSJSONSerialization dataWithJSONObject:value options:0 error:NULL];
+}
+
+- (NSDictionary *)decode:(NSData *)data {
+  id rv = [NSJSONSerialization JSONObjectWithData:data options:0 error:NULL];
+  return [rv isKindOfClass:[NSDictionary class]] ? rv : nil;
+}
+
+@end
@@ -0,0 +1,51 @@
+//
+// FNCacheRegistry.h
+//
+// Copyright (c) 2013 Fauna, Inc.
+//
+// Licensed under the Mozilla Public License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain a
+// copy of the License at
+//
+// http://mozilla.org/MPL/2.0/
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+@class FNCache;
+
+/*!
+ Shares caches across the process. Contexts for the same auth identity acquire the same cache rather than each opening the database. Caches are reference counted, and closed once nothing has held them for idleTimeout.
+
+ Each open SQLite cache costs one writer connection, run on one of 4 worker threads shared by every cache, and up to 2 idle read-only connections. Reads from every cache run on one shared queue of 4 threads.
+ */
+@interface FNCacheRegistry : NSObject
+
+/*!
+ Seconds an unreferenced cache stays open, so contexts created and dropped in quick succession do not reopen it. Defaults to 30.
+ */
+@property (nonatomic) NSTimeInterval idleTimeout;
+
++ (FNCacheRegistry *)sharedRegistry;
+
+/*!
+ Returns the open cache registered under name, calling create to open one if there is none. Every acquire must be balanced by a releaseCacheNamed:. Only the first caller's create is used, so settings such as size come from whichever caller opened the cache.
+ */
+- (FNCache *)acquireCacheNamed:(NSString *)name create:(FNCache *(^)(void))create;
+
+/*!
+ Balances an acquireCacheNamed:create:. A release without a matching acquire is logged and otherwise ignored.
+ */
+- (void)releaseCacheNamed:(NSString *)name;
+
+/*!
+ Returns the number of caches currently open, referenced or idle.
+ */
+- (NSUInteger)count;
+
+@end
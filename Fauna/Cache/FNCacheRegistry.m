@@ -0,0 +1,128 @@
+//
+// FNCacheRegistry.m
+//
+// Copyright (c) 2013 Fauna, Inc.
+//
+// Licensed under the Mozilla Public License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain a
+// copy of the License at
+//
+// http://mozilla.org/MPL/2.0/
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+//
+
+#import "FNCacheRegistry.h"
+#import "FNCache.h"
+#import "FNTimerWheel.h"
+
+@interface FNCacheRegistryEntry : NSObject
+
+@property (nonatomic, readonly) FNCache *cache;
+@property (nonatomic) NSUInteger references;
+@property (nonatomic) id idleTimer;
+
+@end
+
+@implementation FNCacheRegistryEntry
+
+- (id)initWithCache:(FNCache *)cache {
+  if (self = [super init]) {
+    _cache = cache;
+  }
+  return self;
+}
+
+@end
+
+@interface FNCacheRegistry ()
+
+@property (nonatomic, readonly) NSMutableDictionary *entries;
+
+@end
+
+@implementation FNCacheRegistry
+
+#pragma mark lifecycle
+
+- (id)init {
+  if (self = [super init]) {
+    _entries = [NSMutableDictionary new];
+    _idleTimeout = 30;
+  }
+  return self;
+}
+
++ (FNCacheRegistry *)sharedRegistry {
+  static FNCacheRegistry *registry;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    registry = [FNCacheRegistry new];
+  });
+
+  return registry;
+}
+
+#pragma mark Public methods
+
+- (FNCache *)acquireCacheNamed:(NSString *)name create:(FNCache *(^)(void))create {
+  @synchronized (self) {
+    FNCacheRegistryEntry *entry = self.entries[name];
+
+    if (!entry) {
+      entry = [[FNCacheRegistryEntry alloc] initWithCache:create()];
+      self.entries[name] = entry;
+    }
+
+    if (entry.idleTimer) {
+      [[FNTimerWheel sharedWheel] cancelTimer:entry.idleTimer];
+      entry.idleTimer = nil;
+    }
+
+    entry.references++;
+    return entry.cache;
+  }
+}
+
+- (void)releaseCacheNamed:(NSString *)name {
+  @synchronized (self) {
+    FNCacheRegistryEntry *entry = self.entries[name];
+
+    // Contexts release from -dealloc, where an exception would be fatal, so
+    // an unbalanced release is only logged.
+    if (!entry || entry.references == 0) {
+      NSLog(@"Cache %@ released more often than acquired.", name);
+      return;
+    }
+
+    if (--entry.references > 0) return;
+
+    entry.idleTimer = [[FNTimerWheel sharedWheel] scheduleAfter:self.idleTimeout block:^{
+      [self closeEntry:entry named:name];
+    }];
+  }
+}
+
+- (NSUInteger)count {
+  @synchronized (self) {
+    return self.entries.count;
+  }
+}
+
+#pragma mark Private methods
+
+- (void)closeEntry:(FNCacheRegistryEntry *)entry named:(NSString *)name {
+  @synchronized (self) {
+    // A timer may fire as a new acquire cancels it; the cache must then stay
+    // open for as long as it is referenced.
+    if (self.entries[name] != entry || entry.references > 0) return;
+    [self.entries removeObjectForKey:name];
+  }
+
+  [entry.cache close];
+}
+
+@end
@@ -24,6 +24,10 @@
   return [FNFuture value:nil];
 }
 
+- (FNFuture *)setObjects:(NSArray *)values timestamp:(FNTimestamp)timestamp {
+  return [FNFuture value:nil];
+}
+
 - (FNFuture *)removeObjectForPath:(NSString *)path timestamp:(FNTimestamp)timestamp {
   return [FNFuture value:nil];
 }
@@ -32,4 +36,8 @@
   return [FNFuture value:nil];
 }
 
+- (FNFuture *)objectsForPaths:(NSArray *)paths after:(FNTimestamp)after {
+  return [FNFuture value:@{}];
+}
+
 @end
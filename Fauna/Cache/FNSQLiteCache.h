@@ -17,19 +17,71 @@
 
 #import <Foundation/Foundation.h>
 #import "FNCache.h"
+#import "FNCacheCodec.h"
 
 @class FNFuture;
 
 @interface FNSQLiteCache : FNCache
 
+/*!
+ How long, in seconds, a write waits for others to share its transaction. Writes queued while the connection is busy always share the next transaction. 0 commits as soon as the connection is free. Defaults to 2ms, and is timed precisely rather than on the coarser shared timer wheel.
+ */
+@property (nonatomic) NSTimeInterval groupCommitWindow;
+
+/*!
+ How long, in seconds, the writer and readers let SQLite wait on a lock held by another connection before retrying. Defaults to 0, leaving waiting to the retries.
+ */
+@property (nonatomic) NSTimeInterval busyTimeout;
+
+/*!
+ How many times a statement that finds the database busy or locked is retried, with backoff, before its operation fails. Defaults to 8.
+ */
+@property (nonatomic) NSUInteger maxBusyRetries;
+
+/*!
+ The codec new entries are written with. Entries are read back with whichever codec wrote them, and rewritten with this one in the background. Defaults to FNBinaryCodec.
+ */
+@property (nonatomic) id<FNCacheCodec> codec;
+
+/*!
+ Completes once the database is open and its schema is current, or fails if it could not be set up. The database is opened in the background; operations issued before then wait for it.
+ */
+@property (nonatomic, readonly) FNFuture *ready;
+
+/*!
+ maxSize bounds the bytes of cached data. Past it, the least recently read or written entries are evicted until the cache is back under 80% of maxSize.
+ */
 - (id)initWithSQLitePath:(NSString *)path maxSize:(NSUInteger)maxSize;
 
+/*!
+ Opens the cache in WAL mode with one writer and read-only connections, keeping up to the given number of them open, so reads need not wait behind writes. With 0 readers all operations run on the writer.
+ */
+- (id)initWithSQLitePath:(NSString *)path maxSize:(NSUInteger)maxSize readers:(NSUInteger)readers;
+
 - (id)initWithName:(NSString *)name maxSize:(NSUInteger)maxSize;
 
 + (id)cacheWithName:(NSString *)name maxSize:(NSUInteger)maxSize;
 
+/*!
+ Renames the files of a closed named cache. Does nothing and returns NO if there is no cache under name or there already is one under newName.
+ */
++ (BOOL)moveCacheNamed:(NSString *)name toName:(NSString *)newName;
+
+/*!
+ Deletes the files of a closed named cache, if any.
+ */
++ (void)removeCacheNamed:(NSString *)name;
+
+/*!
+ The size of the database file. Eviction returns freed pages to the file system, except in files written before incremental vacuum that were too large (over 4MB) to convert on open: those keep their size and reuse the freed pages.
+ */
 - (long long)fileSize;
 
+/*!
+ The number of times statements on the cache's writer or readers found the database busy or locked, for example because another process held it.
+ */
+- (NSUInteger)contentionCount;
+
 - (void)close;
 
 @end
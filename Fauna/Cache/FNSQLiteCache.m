@@ -16,24 +16,38 @@
 //
 
 #import "FNSQLiteCache.h"
+#import "FNCacheCodec.h"
 #import "FNFuture.h"
+#import "FNMutableFuture.h"
+#import "FNTimerWheel.h"
 #import "FNResource.h"
 #import "FNSQLiteConnectionThread.h"
 #import "FNSQLiteConnection.h"
+#import "FNSQLiteReaderPool.h"
 #import <sqlite3.h>
-
-#define CacheVersion 2
-#define CacheCleanupPageSize 100
-#define CacheCleanupCheckOdds 100
-#define CacheCleanupThreshold 0.8
-#define CacheCleanupRepeatThreshold 1.0
-#define CacheCleanupVacuumThreshold 1.2
+#import <dispatch/dispatch.h>
+
+#define CacheVersion 4
+#define CacheOldestMigratableVersion 2
+#define CacheDefaultReaders 2
+#define CacheDefaultGroupCommitWindow 0.002
+#define CacheAccessFlushInterval 30.0
+#define CacheAccessFlushThreshold 256
+#define CacheRowOverhead 64
+#define CacheEvictionBatchSize 64
+#define CacheEvictionLowWater 0.8
+#define CacheMaxPathsPerQuery 512
+#define CacheReencodeBatchSize 100
+#define CacheMaxVacuumConversionSize (4 * 1024 * 1024)
 
 static NSString * const ResourcesDDL = @"\
 CREATE TABLE IF NOT EXISTS resources ( \
   id INTEGER PRIMARY KEY NOT NULL, \
   data BLOB, \
+  codec INTEGER NOT NULL DEFAULT 0, \
+  size INTEGER NOT NULL DEFAULT 0, \
   timestamp INTEGER NOT NULL, \
+  accessed INTEGER NOT NULL DEFAULT 0, \
   deleted INTEGER NOT NULL DEFAULT 0 \
 )";
 
@@ -44,16 +58,184 @@ CREATE TABLE IF NOT EXISTS resource_aliases ( \
   derived INTEGER NOT NULL \
 )";
 
-static NSString * const ResourcesByTimestamp = @"CREATE INDEX IF NOT EXISTS by_timestamp on resources (timestamp ASC)";
+static NSString * const ResourcesByAccessed = @"CREATE INDEX IF NOT EXISTS by_accessed on resources (accessed ASC)";
 
 static NSString * const ResourceAliasesByResourceID = @"CREATE INDEX IF NOT EXISTS by_resource_id on resource_aliases (resource_id ASC)";
 
+// The total size of all resources, kept current by triggers so eviction
+// never has to scan the table or stat the file.
+
+static NSString * const CacheStatsDDL = @"CREATE TABLE IF NOT EXISTS cache_stats (size INTEGER NOT NULL)";
+
+static NSString * const ResourcesSizeInsertTrigger = @"CREATE TRIGGER IF NOT EXISTS size_on_insert AFTER INSERT ON resources \
+BEGIN UPDATE cache_stats SET size = size + NEW.size; END";
+
+static NSString * const ResourcesSizeUpdateTrigger = @"CREATE TRIGGER IF NOT EXISTS size_on_update AFTER UPDATE OF size ON resources \
+BEGIN UPDATE cache_stats SET size = size + NEW.size - OLD.size; END";
+
+static NSString * const ResourcesSizeDeleteTrigger = @"CREATE TRIGGER IF NOT EXISTS size_on_delete AFTER DELETE ON resources \
+BEGIN UPDATE cache_stats SET size = size - OLD.size; END";
+
+// Statements run on every read and write, registered with the connection
+// once the tables exist.
+
+static NSString * const SelectObjectByAlias = @"SELECT r.data, r.deleted, r.codec, r.id, r.timestamp FROM resources AS r \
+JOIN resource_aliases as a on r.id = a.resource_id \
+WHERE a.alias = ? AND r.timestamp >= ?";
+
+// Followed by the IN list and the timestamp bound; see SelectObjectsByAliases().
+static NSString * const SelectObjectsByAliasesPrefix = @"SELECT r.data, r.deleted, r.codec, r.id, r.timestamp, a.alias FROM resources AS r \
+JOIN resource_aliases as a on r.id = a.resource_id \
+WHERE a.alias IN ";
+
+static NSString * const SelectResourceIDByAlias = @"SELECT resource_id FROM resource_aliases WHERE alias = ?";
+
+static NSString * const DeleteDerivedAliases = @"DELETE FROM resource_aliases WHERE resource_id = ? AND derived = 1";
+
+static NSString * const UpdateResource = @"UPDATE resources SET data = ?, codec = ?, size = ?, timestamp = ?, accessed = ?, deleted = 0 WHERE id = ?";
+
+static NSString * const InsertResource = @"INSERT INTO resources (data, codec, size, timestamp, accessed) VALUES (?, ?, ?, ?, ?)";
+
+static NSString * const ReplaceAlias = @"REPLACE INTO resource_aliases (alias, resource_id, derived) VALUES (?, ?, 0)";
+
+static NSString * const ReplaceDerivedAlias = @"REPLACE INTO resource_aliases (alias, resource_id, derived) VALUES (?, ?, 1)";
+
+static NSString * const TouchResource = @"UPDATE resources SET accessed = ? WHERE id = ?";
+
+static NSString * const SelectCacheSize = @"SELECT size FROM cache_stats";
+
+static NSString * const SelectLeastRecent = @"SELECT id, size FROM resources ORDER BY accessed ASC, id ASC LIMIT ?";
+
+static NSString * const DeleteAliases = @"DELETE FROM resource_aliases WHERE resource_id = ?";
+
+static NSString * const DeleteResource = @"DELETE FROM resources WHERE id = ?";
+
+static NSString * const IncrementalVacuum = @"PRAGMA incremental_vacuum(128)";
+
+static NSString * const SelectStaleEncodings = @"SELECT id, data, codec FROM resources \
+WHERE id > ? AND codec != ? AND data IS NOT NULL ORDER BY id ASC LIMIT ?";
+
+static NSString * const UpdateEncoding = @"UPDATE resources SET data = ?, codec = ?, size = ? WHERE id = ? AND codec = ?";
+
+typedef BOOL (^CacheMigration)(FNSQLiteConnection *db);
+
+// Migrations[i] upgrades the schema from CacheOldestMigratableVersion + i to
+// the next version. Each runs in a transaction with its version bump, so an
+// interrupted upgrade resumes where it stopped. Anything older is rebuilt.
+static NSArray * Migrations(void) {
+  static NSArray *migrations;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    migrations = @[
+      // 3: values record the codec that wrote them. Existing rows are keyed
+      // archives, the column default.
+      ^BOOL(FNSQLiteConnection *db) {
+        return [db execute:@"ALTER TABLE resources ADD COLUMN codec INTEGER NOT NULL DEFAULT 0" error:NULL];
+      },
+
+      // 4: per-row sizes with a running total, and access recency.
+      ^BOOL(FNSQLiteConnection *db) {
+        NSString *backfill = [NSString stringWithFormat:@"UPDATE resources SET size = COALESCE(length(data), 0) + %d, accessed = timestamp", CacheRowOverhead];
+
+        return [db execute:@"ALTER TABLE resources ADD COLUMN size INTEGER NOT NULL DEFAULT 0" error:NULL] &&
+               [db execute:@"ALTER TABLE resources ADD COLUMN accessed INTEGER NOT NULL DEFAULT 0" error:NULL] &&
+               [db execute:backfill error:NULL] &&
+               [db execute:@"DROP INDEX IF EXISTS by_timestamp" error:NULL] &&
+               [db execute:ResourcesByAccessed error:NULL] &&
+               [db execute:CacheStatsDDL error:NULL] &&
+               [db execute:@"INSERT INTO cache_stats (size) SELECT COALESCE(SUM(size), 0) FROM resources" error:NULL] &&
+               [db execute:ResourcesSizeInsertTrigger error:NULL] &&
+               [db execute:ResourcesSizeUpdateTrigger error:NULL] &&
+               [db execute:ResourcesSizeDeleteTrigger error:NULL];
+      },
+    ];
+
+    NSCAssert(CacheOldestMigratableVersion + (int)migrations.count == CacheVersion, @"missing cache migration");
+  });
+
+  return migrations;
+}
+
+
+// IN list lengths are rounded up to a power of two, padded with NULLs that
+// match nothing, so lookups share at most ten distinct statements instead of
+// one per length churning the connection's statement cache.
+static NSUInteger SelectObjectsByAliasesLength(NSUInteger count) {
+  NSUInteger length = 1;
+  while (length < count) length <<= 1;
+  return length;
+}
+
+static NSString * SelectObjectsByAliases(NSUInteger count) {
+  NSMutableString *sql = [NSMutableString stringWithString:SelectObjectsByAliasesPrefix];
+
+  [sql appendString:@"(?"];
+  for (NSUInteger i = 1; i < count; i++) [sql appendString:@", ?"];
+  [sql appendString:@") AND r.timestamp >= ?"];
+
+  return sql;
+}
+
+static NSString * CachePathForName(NSString *name) {
+  NSArray *searchPaths = NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES);
+  NSString *cachePath = [searchPaths objectAtIndex:0];
+  return [cachePath stringByAppendingPathComponent:[NSString stringWithFormat:@"%@-cache.db", name]];
+}
+
+// A database in WAL mode may leave these beside the main file.
+static NSArray * CacheFileSuffixes(void) {
+  return @[@"", @"-wal", @"-shm"];
+}
+
+// Returns a future with the same result that does not forward cancellation,
+// so callers chaining off a shared future cannot cancel it for everyone.
+static FNFuture * Uncancellable(FNFuture *future) {
+  FNMutableFuture *rv = [FNMutableFuture new];
+
+  [future onCompletion:^(FNFuture *result) {
+    if (result.isError) {
+      [rv updateErrorIfEmpty:result.error];
+    } else {
+      [rv updateIfEmpty:result.value];
+    }
+  } on:[FNInlineExecutor sharedExecutor]];
+
+  return rv;
+}
+
+@interface FNSQLiteCacheWrite : NSObject
+
+@property (nonatomic, readonly) BOOL (^body)(FNSQLiteConnection *db);
+@property (nonatomic, readonly) FNMutableFuture *future;
+
+- (id)initWithBody:(BOOL (^)(FNSQLiteConnection *db))body;
+
+@end
+
+@implementation FNSQLiteCacheWrite
 
-@interface FNSQLiteCache ()
+- (id)initWithBody:(BOOL (^)(FNSQLiteConnection *db))body {
+  if (self = [super init]) {
+    _body = [body copy];
+    _future = [FNMutableFuture new];
+  }
+  return self;
+}
+
+@end
+
+@interface FNSQLiteCache () {
+  // Writes enqueued but not yet committed (or failed).
+  int64_t volatile _unflushedWrites;
+}
 
 @property (nonatomic, readonly) NSUInteger maxSize;
 @property (nonatomic, readonly) NSString *filepath;
 @property (nonatomic, readonly) FNSQLiteConnectionThread *connection;
+@property (nonatomic, readonly) FNSQLiteReaderPool *readers;
+@property (nonatomic, readonly) NSMutableArray *pendingWrites;
+@property (nonatomic, readonly) NSMutableSet *accessedIDs;
+@property (nonatomic) BOOL isFlushScheduled;
 
 @end
 
@@ -62,22 +244,40 @@ static NSString * const ResourceAliasesByResourceID = @"CREATE INDEX IF NOT EXIS
 #pragma mark lifecycle
 
 - (id)initWithSQLitePath:(NSString *)path maxSize:(NSUInteger)maxSize {
+  return [self initWithSQLitePath:path maxSize:maxSize readers:CacheDefaultReaders];
+}
+
+- (id)initWithSQLitePath:(NSString *)path maxSize:(NSUInteger)maxSize readers:(NSUInteger)readers {
   if(self = [super init]) {
     _maxSize = maxSize;
     _filepath = path;
     _connection = [[FNSQLiteConnectionThread alloc] initWithSQLitePath:path];
+    _pendingWrites = [NSMutableArray new];
+    _accessedIDs = [NSMutableSet new];
+    _groupCommitWindow = CacheDefaultGroupCommitWindow;
+    _codec = [FNBinaryCodec new];
+
+    // Readers open lazily, after ready; see withReadConnection:.
+    if (readers > 0) _readers = [[FNSQLiteReaderPool alloc] initWithSQLitePath:path size:readers];
+
+    _ready = Uncancellable([self createOrUpdateTables]);
 
-    [self createOrUpdateTables];
+    // Queued straight from the writer as setup finishes, without waiting on
+    // the main thread.
+    [_ready onCompletion:^(FNFuture *result) {
+      if (result.isError) {
+        NSLog(@"Cache initialization failed: %@", result.error);
+      } else {
+        [self convertToIncrementalVacuum];
+        [self reencodeAfter:0 codec:self.codec];
+      }
+    } on:[FNInlineExecutor sharedExecutor]];
   }
   return self;
 }
 
 - (id)initWithName:(NSString *)name maxSize:(NSUInteger)maxSize {
-  NSArray *searchPaths = NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES);
-  NSString *cachePath = [searchPaths objectAtIndex:0];
-  NSString *databasePath = [cachePath stringByAppendingPathComponent:[NSString stringWithFormat:@"%@-cache.db", name]];
-
-  return [self initWithSQLitePath:databasePath maxSize:maxSize];
+  return [self initWithSQLitePath:CachePathForName(name) maxSize:maxSize];
 }
 
 - (void)dealloc {
@@ -90,47 +290,249 @@ static NSString * const ResourceAliasesByResourceID = @"CREATE INDEX IF NOT EXIS
   return [[FNSQLiteCache alloc] initWithName:name maxSize:maxSize];
 }
 
++ (BOOL)moveCacheNamed:(NSString *)name toName:(NSString *)newName {
+  NSFileManager *fm = [NSFileManager defaultManager];
+  NSString *from = CachePathForName(name);
+  NSString *to = CachePathForName(newName);
+
+  if (![fm fileExistsAtPath:from] || [fm fileExistsAtPath:to]) return NO;
+
+  for (NSString *suffix in CacheFileSuffixes()) {
+    NSString *file = [from stringByAppendingString:suffix];
+    NSError *error;
+
+    if ([fm fileExistsAtPath:file] && ![fm moveItemAtPath:file toPath:[to stringByAppendingString:suffix] error:&error]) {
+      NSLog(@"Could not move cache file %@: %@", file, error);
+
+      // A partial move is worse than starting over, so take back what moved.
+      for (NSString *moved in CacheFileSuffixes()) {
+        if (moved == suffix) break;
+        [fm moveItemAtPath:[to stringByAppendingString:moved] toPath:[from stringByAppendingString:moved] error:nil];
+      }
+      return NO;
+    }
+  }
+
+  return YES;
+}
+
++ (void)removeCacheNamed:(NSString *)name {
+  NSFileManager *fm = [NSFileManager defaultManager];
+  NSString *path = CachePathForName(name);
+
+  for (NSString *suffix in CacheFileSuffixes()) {
+    NSString *file = [path stringByAppendingString:suffix];
+    if ([fm fileExistsAtPath:file]) [fm removeItemAtPath:file error:nil];
+  }
+}
+
 #pragma mark Public methods
 
+- (void)setCodec:(id<FNCacheCodec>)codec {
+  _codec = codec;
+  [self reencodeAfter:0 codec:codec];
+}
+
+- (NSTimeInterval)busyTimeout {
+  return self.connection.busyTimeout;
+}
+
+- (void)setBusyTimeout:(NSTimeInterval)busyTimeout {
+  self.connection.busyTimeout = busyTimeout;
+  self.readers.busyTimeout = busyTimeout;
+}
+
+- (NSUInteger)maxBusyRetries {
+  return self.connection.maxBusyRetries;
+}
+
+- (void)setMaxBusyRetries:(NSUInteger)maxBusyRetries {
+  self.connection.maxBusyRetries = maxBusyRetries;
+  self.readers.maxBusyRetries = maxBusyRetries;
+}
+
 - (long long)fileSize {
   return [[[NSFileManager defaultManager] attributesOfItemAtPath:self.filepath error:nil][NSFileSize] longLongValue];
 }
 
+- (NSUInteger)contentionCount {
+  return self.connection.contentionCount + self.readers.contentionCount;
+}
+
 - (void)close {
+  [self.readers close];
   [self.connection close];
 }
 
 #pragma mark FNCache
 
 - (FNFuture *)objectForPath:(NSString *)path after:(FNTimestamp)after {
-  return [self.connection withConnection:^id(FNSQLiteConnection *db) {
-    NSError __autoreleasing *err;
+  return [self withReadConnection:^id(FNSQLiteConnection *db) {
+    id rv = [self readObjectForPath:path after:after db:db];
+    return [rv isKindOfClass:[FNCachedObject class]] ? [rv value] : rv;
+  }];
+}
 
-    NSArray *res = [db select:@"SELECT r.data, r.deleted FROM resources AS r \
-                                JOIN resource_aliases as a on r.id = a.resource_id \
-                                WHERE a.alias = ? AND r.timestamp >= ?"
-                   parameters:@[path, FNTimestampToNSNumber(after)]
-                        error:&err];
+- (FNFuture *)cachedObjectForPath:(NSString *)path after:(FNTimestamp)after {
+  return [self withReadConnection:^id(FNSQLiteConnection *db) {
+    return [self readObjectForPath:path after:after db:db];
+  }];
+}
 
-    if (!res) {
-      NSLog(@"cache read error: %@", err);
-      return CacheReadError();
-    } else if (res.count == 0) {
-      return nil;
-    } else {
-      NSNumber *deleted = res[0][1];
-      return deleted.boolValue ? FNCacheTombstone : [NSKeyedUnarchiver unarchiveObjectWithData:res[0][0]];
+- (FNFuture *)objectsForPaths:(NSArray *)paths after:(FNTimestamp)after {
+  if (paths.count == 0) return [FNFuture value:@{}];
+
+  return [self withReadConnection:^id(FNSQLiteConnection *db) {
+    NSMutableDictionary *rv = [NSMutableDictionary dictionaryWithCapacity:paths.count];
+    NSNumber *ts = FNTimestampToNSNumber(after);
+
+    // Chunked to stay under SQLite's limit on bound parameters.
+    for (NSUInteger start = 0; start < paths.count; start += CacheMaxPathsPerQuery) {
+      NSArray *chunk = [paths subarrayWithRange:NSMakeRange(start, MIN(CacheMaxPathsPerQuery, paths.count - start))];
+      NSError __autoreleasing *err;
+
+      NSUInteger length = SelectObjectsByAliasesLength(chunk.count);
+      NSMutableArray *params = [NSMutableArray arrayWithArray:chunk];
+
+      while (params.count < length) [params addObject:[NSNull null]];
+      [params addObject:ts];
+
+      FNSQLiteCursor *cursor = [db query:SelectObjectsByAliases(length) parameters:params error:&err];
+
+      while ([cursor next]) {
+        NSString *path = [cursor textAt:5];
+        FNCachedObject *cached = [self cachedObjectFromCursor:cursor path:path];
+        if (cached) rv[path] = cached.value;
+      }
+
+      err = cursor ? cursor.error : err;
+      [cursor close];
+
+      if (err) {
+        NSLog(@"cache read error: %@", err);
+        return CacheReadError();
+      }
     }
+
+    return rv;
   }];
 }
 
 - (FNFuture *)setObject:(NSDictionary *)value extraPaths:(NSArray *)extraPaths timestamp:(FNTimestamp)timestamp {
   NSParameterAssert(value[@"ref"]);
 
+  NSArray *encoded = [self encodeObject:value];
+  NSNumber *ts = FNTimestampToNSNumber(timestamp);
+
+  FNFuture *rv = [self enqueueWrite:^(FNSQLiteConnection *db) {
+    return [self writeObject:value encoded:encoded extraPaths:extraPaths timestamp:ts db:db];
+  }];
+
+  return rv;
+}
+
+- (FNFuture *)setObjects:(NSArray *)values timestamp:(FNTimestamp)timestamp {
+  if (values.count == 0) return [FNFuture value:nil];
+
+  NSMutableArray *encoded = [NSMutableArray arrayWithCapacity:values.count];
+  NSNumber *ts = FNTimestampToNSNumber(timestamp);
+
+  for (NSDictionary *value in values) {
+    NSParameterAssert(value[@"ref"]);
+    [encoded addObject:[self encodeObject:value]];
+  }
+
+  FNFuture *rv = [self enqueueWrite:^(FNSQLiteConnection *db) {
+    for (NSUInteger i = 0; i < values.count; i++) {
+      if (![self writeObject:values[i] encoded:encoded[i] extraPaths:@[] timestamp:ts db:db]) return NO;
+    }
+
+    return YES;
+  }];
+
+  return rv;
+}
+
+- (FNFuture *)removeObjectForPath:(NSString *)path timestamp:(FNTimestamp)timestamp {
+  NSNumber *ts = FNTimestampToNSNumber(timestamp);
+
+  FNFuture *rv = [self enqueueWrite:^(FNSQLiteConnection *db) {
+    NSNumber *now = FNTimestampToNSNumber(FNNow());
+    NSArray *prev = [db select:SelectResourceIDByAlias parameters:@[path] error:NULL];
+    NSNumber *resID = (prev && prev.count > 0) ? prev[0][0] : nil;
+
+    if (resID) {
+      if (![db execute:@"UPDATE resources SET data = NULL, size = ?, timestamp = ?, accessed = ?, deleted = 1 WHERE id = ?" parameters:@[@(CacheRowOverhead), ts, now, resID] error:NULL]) return NO;
+    } else {
+      if (![db execute:@"INSERT INTO resources (size, timestamp, accessed, deleted) VALUES (?, ?, ?, 1)" parameters:@[@(CacheRowOverhead), now, now] error:NULL]) return NO;
+      if (![db execute:@"INSERT INTO resource_aliases (alias, resource_id, derived) VALUES (?, ?, 0)" parameters:@[path, @(db.lastRowID)] error:NULL]) return NO;
+    }
+
+    return YES;
+  }];
+
+  return rv;
+}
+
+#pragma mark Private methods
+
+// Decodes the current row of a select whose first columns are data,
+// deleted, codec, id and timestamp, noting the access.
+- (FNCachedObject *)cachedObjectFromCursor:(FNSQLiteCursor *)cursor path:(NSString *)path {
+  id value = nil;
+
+  if ([cursor int64At:1]) {
+    value = FNCacheTombstone;
+  } else {
+    // Rows keep the codec they were written with; one that can no longer
+    // be decoded reads as a miss.
+    FNCacheCodecID codecID = (FNCacheCodecID)[cursor int64At:2];
+    value = [FNCacheCodecWithID(codecID) decode:[cursor blobNoCopyAt:0]];
+    if (!value) NSLog(@"cache entry for %@ could not be decoded with codec %d", path, codecID);
+  }
+
+  [self recordAccess:@([cursor int64At:3])];
+
+  return value ? [[FNCachedObject alloc] initWithValue:value timestamp:(FNTimestamp)[cursor int64At:4]] : nil;
+}
+
+// Returns an FNCachedObject, nil on a miss, or an error.
+- (id)readObjectForPath:(NSString *)path after:(FNTimestamp)after db:(FNSQLiteConnection *)db {
+  NSError __autoreleasing *err;
+
+  FNSQLiteCursor *cursor = [db query:SelectObjectByAlias parameters:@[path, FNTimestampToNSNumber(after)] error:&err];
+  id rv = nil;
+
+  if ([cursor next]) rv = [self cachedObjectFromCursor:cursor path:path];
+
+  err = cursor ? cursor.error : err;
+  [cursor close];
+
+  if (err) {
+    NSLog(@"cache read error: %@", err);
+    return CacheReadError();
+  } else {
+    return rv;
+  }
+}
+
+// Returns the data and the id of the codec that produced it. Values the
+// configured codec cannot represent fall back to a keyed archive.
+- (NSArray *)encodeObject:(NSDictionary *)value {
+  id<FNCacheCodec> codec = self.codec;
+  NSData *data = [codec encode:value];
+
+  if (!data) {
+    codec = FNCacheCodecWithID(FNCacheCodecKeyedArchiver);
+    data = [codec encode:value];
+  }
+
+  return @[data, @(codec.identifier)];
+}
+
+- (BOOL)writeObject:(NSDictionary *)value encoded:(NSArray *)encoded extraPaths:(NSArray *)extraPaths timestamp:(NSNumber *)ts db:(FNSQLiteConnection *)db {
   NSString *ref = value[@"ref"];
   NSString *uniqueID = value[@"unique_id"];
-  NSData *data = [NSKeyedArchiver archivedDataWithRootObject:value];
-  NSNumber *ts = FNTimestampToNSNumber(timestamp);
 
   NSMutableArray *derivedPaths = [NSMutableArray new];
 
@@ -141,70 +543,254 @@ static NSString * const ResourceAliasesByResourceID = @"CREATE INDEX IF NOT EXIS
     [derivedPaths addObject:[value[@"class"] stringByAppendingFormat:@"/%@", uniqueID]];
   }
 
-  FNFuture *rv = [self.connection withConnection:^(FNSQLiteConnection *db) {
-    BOOL success = [db withTransaction:^{
-      NSArray *prev = [db select:@"SELECT resource_id FROM resource_aliases WHERE alias = ?" parameters:@[ref] error:NULL];
-      NSNumber *resID = (prev && prev.count > 0) ? prev[0][0] : nil;
+  NSArray *prev = [db select:SelectResourceIDByAlias parameters:@[ref] error:NULL];
+  NSNumber *resID = (prev && prev.count > 0) ? prev[0][0] : nil;
+  NSNumber *size = @([encoded[0] length] + CacheRowOverhead);
+  NSNumber *now = FNTimestampToNSNumber(FNNow());
 
-      if (resID) {
-        if (![db execute:@"DELETE FROM resource_aliases WHERE resource_id = ? AND derived = 1" parameters:@[resID] error:NULL]) return NO;
-        if (![db execute:@"UPDATE resources SET data = ?, timestamp = ?, deleted = 0 WHERE id = ?" parameters:@[data, ts, resID] error:NULL]) return NO;
-      } else {
-        if (![db execute:@"INSERT INTO resources (data, timestamp) VALUES (?, ?)" parameters:@[data, ts] error:NULL]) return NO;
-        resID = @(db.lastRowID);
-      }
+  if (resID) {
+    if (![db execute:DeleteDerivedAliases parameters:@[resID] error:NULL]) return NO;
+    if (![db execute:UpdateResource parameters:@[encoded[0], encoded[1], size, ts, now, resID] error:NULL]) return NO;
+  } else {
+    if (![db execute:InsertResource parameters:@[encoded[0], encoded[1], size, ts, now] error:NULL]) return NO;
+    resID = @(db.lastRowID);
+  }
+
+  for (NSString *path in extraPaths) {
+    if (![db execute:ReplaceAlias parameters:@[path, resID] error:NULL]) return NO;
+  }
+
+  for (NSString *path in derivedPaths) {
+    if (![db execute:ReplaceDerivedAlias parameters:@[path, resID] error:NULL]) return NO;
+  }
+
+  return YES;
+}
+
+- (FNFuture *)enqueueWrite:(BOOL (^)(FNSQLiteConnection *db))body {
+  FNSQLiteCacheWrite *write = [[FNSQLiteCacheWrite alloc] initWithBody:body];
+  BOOL schedule = NO;
+
+  // Counted before the write is visible to a flush, so a read issued after
+  // this returns always sees it as outstanding.
+  __sync_add_and_fetch(&_unflushedWrites, 1);
+
+  @synchronized (self.pendingWrites) {
+    [self.pendingWrites addObject:write];
+
+    if (!self.isFlushScheduled) {
+      self.isFlushScheduled = YES;
+      schedule = YES;
+    }
+  }
+
+  if (schedule) {
+    if (self.groupCommitWindow > 0) {
+      // Windows are shorter than a timer wheel tick, which would round them
+      // up to 10ms or more, so they are scheduled directly.
+      dispatch_time_t when = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(self.groupCommitWindow * NSEC_PER_SEC));
+      dispatch_after(when, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        [self flushWrites];
+      });
+    } else {
+      [self flushWrites];
+    }
+  }
+
+  return write.future;
+}
+
+- (NSArray *)takePendingWrites {
+  @synchronized (self.pendingWrites) {
+    NSArray *writes = [self.pendingWrites copy];
+    [self.pendingWrites removeAllObjects];
+    self.isFlushScheduled = NO;
+    return writes;
+  }
+}
 
-      for (NSString *path in extraPaths) {
-        if (![db execute:@"REPLACE INTO resource_aliases (alias, resource_id, derived) VALUES (?, ?, 0)" parameters:@[path, resID] error:NULL]) return NO;
+// Commits every write queued by the time the connection thread gets to it in
+// one transaction. Each write runs in its own savepoint, so one failing only
+// fails its own future.
+- (void)flushWrites {
+  FNFuture *rv = [self.connection withConnection:^id(FNSQLiteConnection *db) {
+    NSArray *writes = [self takePendingWrites];
+
+    // An early flush for a read may have taken everything already.
+    if (writes.count == 0) return nil;
+
+    NSSet *accessed = [self takeAccessedIDs];
+
+    // Setup ran earlier on this thread; without tables nothing can succeed.
+    if (self.ready.isError) {
+      [self writesDidFlush:writes.count];
+      for (FNSQLiteCacheWrite *write in writes) [write.future updateErrorIfEmpty:self.ready.error];
+      return nil;
+    }
+    NSMutableArray *succeeded = [NSMutableArray arrayWithCapacity:writes.count];
+
+    BOOL committed = [db withTransaction:^{
+      NSNumber *now = FNTimestampToNSNumber(FNNow());
+
+      // Recency is best effort; a failed touch does not fail the writes.
+      for (NSNumber *resID in accessed) {
+        [db execute:TouchResource parameters:@[now, resID] error:NULL];
       }
 
-      for (NSString *path in derivedPaths) {
-        if (![db execute:@"REPLACE INTO resource_aliases (alias, resource_id, derived) VALUES (?, ?, 1)" parameters:@[path, resID] error:NULL]) return NO;
+      for (FNSQLiteCacheWrite *write in writes) {
+        if ([db withSavepoint:^{ return write.body(db); }]) {
+          [succeeded addObject:write];
+        } else {
+          [write.future updateErrorIfEmpty:CacheWriteError()];
+        }
       }
 
       return YES;
     }];
 
-    return success ? nil : CacheWriteError();
+    // Committed, so readers may serve what these wrote.
+    [self writesDidFlush:writes.count];
+
+    for (FNSQLiteCacheWrite *write in succeeded) {
+      if (committed) {
+        [write.future updateIfEmpty:nil];
+      } else {
+        [write.future updateErrorIfEmpty:CacheWriteError()];
+      }
+    }
+
+    if (committed) [self evictIfNeeded:db];
+
+    return nil;
   }];
 
-  [self checkCleanupTables];
+  // If the connection has closed the block never runs; fail what it would
+  // have written.
+  [rv onCompletion:^(FNFuture *result) {
+    if (!result.isError) return;
 
-  return rv;
+    NSArray *writes = [self takePendingWrites];
+    [self writesDidFlush:writes.count];
+
+    for (FNSQLiteCacheWrite *write in writes) {
+      [write.future updateErrorIfEmpty:result.error];
+    }
+  } on:[FNInlineExecutor sharedExecutor]];
 }
 
-- (FNFuture *)removeObjectForPath:(NSString *)path timestamp:(FNTimestamp)timestamp {
-  NSNumber *ts = FNTimestampToNSNumber(timestamp);
+- (void)writesDidFlush:(NSUInteger)count {
+  __sync_sub_and_fetch(&_unflushedWrites, (int64_t)count);
+}
 
-  FNFuture *rv = [self.connection withConnection:^(FNSQLiteConnection *db) {
-    BOOL success = [db withTransaction:^{
-      NSArray *prev = [db select:@"SELECT resource_id FROM resource_aliases WHERE alias = ?" parameters:@[path] error:NULL];
-      NSNumber *resID = (prev && prev.count > 0) ? prev[0][0] : nil;
+// Reads run on read-only connections, so the ids they hit are collected here
+// and stamped by the next group commit. Eviction only needs coarse recency, so
+// a write is queued just to carry them only once many have built up, or once
+// they have waited CacheAccessFlushInterval with no write coming along.
+- (void)recordAccess:(NSNumber *)resID {
+  NSUInteger count;
 
-      if (resID) {
-        if (![db execute:@"UPDATE resources SET data = NULL, timestamp = ?, deleted = 1 WHERE id = ?" parameters:@[ts, resID] error:NULL]) return NO;
-      } else {
-        if (![db execute:@"INSERT INTO resources (timestamp, deleted) VALUES (?, 1)" parameters:@[FNTimestampToNSNumber(FNNow())] error:NULL]) return NO;
-        if (![db execute:@"INSERT INTO resource_aliases (alias, resource_id, derived) VALUES (?, ?, 0)" parameters:@[path, @(db.lastRowID)] error:NULL]) return NO;
+  @synchronized (self.accessedIDs) {
+    [self.accessedIDs addObject:resID];
+    count = self.accessedIDs.count;
+  }
+
+  if (count == CacheAccessFlushThreshold) {
+    [self enqueueWrite:^(FNSQLiteConnection *db) { return YES; }];
+  } else if (count == 1) {
+    [[FNTimerWheel sharedWheel] scheduleAfter:CacheAccessFlushInterval block:^{
+      BOOL pending;
+
+      @synchronized (self.accessedIDs) {
+        pending = self.accessedIDs.count > 0;
       }
 
-      return YES;
+      if (pending) [self enqueueWrite:^(FNSQLiteConnection *db) { return YES; }];
     }];
+  }
+}
 
-    return success ? nil : CacheWriteError();
-  }];
+- (NSSet *)takeAccessedIDs {
+  @synchronized (self.accessedIDs) {
+    NSSet *ids = [self.accessedIDs copy];
+    [self.accessedIDs removeAllObjects];
+    return ids;
+  }
+}
 
-  [self checkCleanupTables];
+- (long long)storedSize:(FNSQLiteConnection *)db {
+  NSArray *rows = [db select:SelectCacheSize error:NULL];
+  return rows.count > 0 ? [rows[0][0] longLongValue] : -1;
+}
 
-  return rv;
+// Once the stored bytes pass maxSize, evicts the least recently used entries
+// in batches until they are under a low-water mark, so eviction does not run
+// again on the next write. Freed pages go back to the file a few at a time
+// rather than through a blocking VACUUM; on legacy files too large to convert
+// (see convertToIncrementalVacuum) they are only reused.
+- (void)evictIfNeeded:(FNSQLiteConnection *)db {
+  long long size = [self storedSize:db];
+  if (size <= (long long)self.maxSize) return;
+
+  long long __block excess = size - (long long)(self.maxSize * CacheEvictionLowWater);
+
+  while (excess > 0) {
+    NSArray *victims = [db select:SelectLeastRecent parameters:@[@(CacheEvictionBatchSize)] error:NULL];
+    if (victims.count == 0) break;
+
+    BOOL evicted = [db withTransaction:^{
+      for (NSArray *row in victims) {
+        if (excess <= 0) break;
+        if (![db execute:DeleteAliases parameters:@[row[0]] error:NULL]) return NO;
+        if (![db execute:DeleteResource parameters:@[row[0]] error:NULL]) return NO;
+        excess -= [row[1] longLongValue];
+      }
+
+      return YES;
+    }];
+
+    if (!evicted) {
+      NSLog(@"Error evicting cache entries: %@", db.lastErrorMessage);
+      return;
+    }
+  }
+
+  NSError __autoreleasing *err;
+  if (![db select:IncrementalVacuum error:&err]) NSLog(@"Error vacuuming cache: %@", err);
 }
 
-#pragma mark Private methods
+// The writer queues reads behind setup on its own. Readers open read-only,
+// so they must wait for the writer to create the database and switch it to
+// WAL. While writes are outstanding, reads go through the writer instead,
+// behind a flush started early, so a caller always reads its own writes.
+- (FNFuture *)withReadConnection:(id(^)(FNSQLiteConnection *db))block {
+  if (!self.readers) return [self.connection withConnection:block];
 
-- (BOOL)createOrUpdateTables {
-  // Creates the Resources table.
-  FNFuture *rv = [self.connection withConnection:^id(FNSQLiteConnection *db) {
+  if (__sync_add_and_fetch(&_unflushedWrites, 0) > 0) {
+    [self flushWrites];
+    return [self.connection withConnection:block];
+  }
+
+  if (self.ready.isCompleted) {
+    return self.ready.isError ? [FNFuture error:self.ready.error] : [self.readers withConnection:block];
+  }
+
+  // Cancelling a read must only cancel that read, not the shared open.
+  return [Uncancellable(self.ready) flatMap:^(id value) {
+    return [self.readers withConnection:block];
+  }];
+}
+
+- (FNFuture *)createOrUpdateTables {
+  return [self.connection withConnection:^id(FNSQLiteConnection *db) {
     NSError __autoreleasing *err;
+
+    // Only takes effect before the first table is created. Existing files
+    // are converted in the background once open.
+    if (![db execute:@"PRAGMA auto_vacuum = INCREMENTAL" error:&err]) return err;
+
+    // WAL lets the read-only connections read while the writer commits.
+    if (![db execute:@"PRAGMA journal_mode = WAL" error:&err]) return err;
+    if (![db execute:@"PRAGMA synchronous = NORMAL" error:&err]) return err;
     if (![db execute:@"CREATE TABLE IF NOT EXISTS version (version INTEGER NOT NULL)" error:&err]) return err;
 
     NSArray *versions = [db select:@"SELECT version from version limit 1" error:&err];
@@ -212,65 +798,130 @@ static NSString * const ResourceAliasesByResourceID = @"CREATE INDEX IF NOT EXIS
 
     if (!versions) return err;
 
-    if (!version || version.intValue != CacheVersion) {
-
-      NSLog(@"Initializing new cache tables.");
-
-      if (![db execute:@"DELETE FROM version" error:&err]) return err;
-      if (![db execute:@"DROP TABLE IF EXISTS resources" error:&err]) return err;
-      if (![db execute:@"DROP TABLE IF EXISTS resource_aliases" error:&err]) return err;
-      if (![db execute:ResourcesDDL error:&err]) return err;
-      if (![db execute:ResourceAliasesDDL error:&err]) return err;
-      if (![db execute:ResourcesByTimestamp error:&err]) return err;
-      if (![db execute:ResourceAliasesByResourceID error:&err]) return err;
+    if (!version) {
+      if (![self rebuildTables:db error:&err]) return err;
+    } else if (version.intValue != CacheVersion) {
+      if (![self migrateFromVersion:version.intValue db:db error:&err]) return err;
+    }
 
-      if (![db execute:@"INSERT INTO version (version) VALUES (?)" parameters:@[@(CacheVersion)] error:&err]) return err;
+    for (NSString *sql in @[SelectObjectByAlias, SelectResourceIDByAlias, DeleteDerivedAliases, UpdateResource, InsertResource, ReplaceAlias, ReplaceDerivedAlias, TouchResource, SelectCacheSize, SelectLeastRecent, DeleteAliases, DeleteResource]) {
+      if (![db registerStatement:sql error:&err]) return err;
     }
 
     return nil;
   }];
+}
 
-  [rv wait];
+- (BOOL)migrateFromVersion:(int)version db:(FNSQLiteConnection *)db error:(NSError * __autoreleasing *)error {
+  if (version < CacheOldestMigratableVersion || version > CacheVersion) {
+    return [self rebuildTables:db error:error];
+  }
 
-  if (rv.isError) {
-    NSLog(@"Cache initialization failed: %@", rv.error);
-    return NO;
-  } else {
-    return YES;
+  NSArray *migrations = Migrations();
+
+  for (int v = version; v < CacheVersion; v++) {
+    CacheMigration migration = migrations[v - CacheOldestMigratableVersion];
+
+    BOOL migrated = [db withTransaction:^{
+      return (BOOL)(migration(db) && [db execute:@"UPDATE version SET version = ?" parameters:@[@(v + 1)] error:NULL]);
+    }];
+
+    if (!migrated) {
+      NSLog(@"Cache migration to version %d failed (%@).", v + 1, db.lastErrorMessage);
+      return [self rebuildTables:db error:error];
+    }
+
+    NSLog(@"Migrated cache tables to version %d.", v + 1);
   }
+
+  return YES;
 }
 
-- (void)checkCleanupTables {
-  if (arc4random() % CacheCleanupCheckOdds == 0) [self cleanupTables];
+- (BOOL)rebuildTables:(FNSQLiteConnection *)db error:(NSError * __autoreleasing *)error {
+  NSLog(@"Initializing new cache tables.");
+
+  if (![db execute:@"DELETE FROM version" error:error]) return NO;
+  if (![db execute:@"DROP TABLE IF EXISTS resources" error:error]) return NO;
+  if (![db execute:@"DROP TABLE IF EXISTS resource_aliases" error:error]) return NO;
+  if (![db execute:@"DROP TABLE IF EXISTS cache_stats" error:error]) return NO;
+
+  if (![db execute:ResourcesDDL error:error]) return NO;
+  if (![db execute:ResourceAliasesDDL error:error]) return NO;
+  if (![db execute:ResourcesByAccessed error:error]) return NO;
+  if (![db execute:ResourceAliasesByResourceID error:error]) return NO;
+  if (![db execute:CacheStatsDDL error:error]) return NO;
+  if (![db execute:@"INSERT INTO cache_stats (size) VALUES (0)" error:error]) return NO;
+  if (![db execute:ResourcesSizeInsertTrigger error:error]) return NO;
+  if (![db execute:ResourcesSizeUpdateTrigger error:error]) return NO;
+  if (![db execute:ResourcesSizeDeleteTrigger error:error]) return NO;
+
+  return [db execute:@"INSERT INTO version (version) VALUES (?)" parameters:@[@(CacheVersion)] error:error];
 }
 
-- (void)cleanupTables {
-  if (self.fileSize > self.maxSize * CacheCleanupThreshold) {
-    FNFuture *rv = [self.connection withConnection:^id(FNSQLiteConnection *db) {
-      NSError __autoreleasing *err;
-      NSArray *rows = [db select:@"SELECT id FROM resources ORDER BY timestamp ASC LIMIT ?" parameters:@[@(CacheCleanupPageSize)] error:&err];
-      if (!rows) return err;
+// Files created before auto_vacuum was set need one full VACUUM to switch
+// over. The writer is a shared worker thread, so only files small enough to
+// rewrite quickly are converted. Larger ones stay on auto_vacuum NONE: eviction
+// still frees their pages for reuse by later writes, but the file never
+// shrinks below its high-water mark until it is rebuilt.
+- (void)convertToIncrementalVacuum {
+  [self.connection withConnection:^id(FNSQLiteConnection *db) {
+    NSArray *autoVacuum = [db select:@"PRAGMA auto_vacuum" error:NULL];
 
-      for (NSArray *resID in rows) {
-        if (![db execute:@"DELETE FROM resource_aliases WHERE resource_id = ?" parameters:resID error:&err]) return err;
-        if (![db execute:@"DELETE FROM resources WHERE id = ?" parameters:resID error:&err]) return err;
-      }
+    // 2 is INCREMENTAL.
+    if (autoVacuum.count == 0 || [autoVacuum[0][0] intValue] == 2) return nil;
 
-      if (self.fileSize > self.maxSize * CacheCleanupVacuumThreshold) {
-        if (![db execute:@"VACUUM" error:&err]) return err;
-      }
+    NSArray *pageCount = [db select:@"PRAGMA page_count" error:NULL];
+    NSArray *pageSize = [db select:@"PRAGMA page_size" error:NULL];
+    if (pageCount.count == 0 || pageSize.count == 0) return nil;
 
+    long long size = [pageCount[0][0] longLongValue] * [pageSize[0][0] longLongValue];
+
+    if (size > CacheMaxVacuumConversionSize) {
+      NSLog(@"Cache file is %lld bytes; leaving it without incremental vacuum.", size);
       return nil;
-    }];
+    }
+
+    NSError __autoreleasing *err;
+    if (![db execute:@"VACUUM" error:&err]) NSLog(@"Error converting cache to incremental vacuum: %@", err);
+
+    return nil;
+  }];
+}
+
+// Rewrites values stored with another codec into the current one, a batch
+// per transaction so writes interleave. Stops once the codec changes again;
+// the new codec starts its own pass.
+- (void)reencodeAfter:(int64_t)lastID codec:(id<FNCacheCodec>)codec {
+  FNFuture *rv = [self.connection withConnection:^id(FNSQLiteConnection *db) {
+    if (self.codec != codec) return nil;
 
-    [rv onSuccess:^(id value) {
-      if (self.fileSize > self.maxSize * CacheCleanupRepeatThreshold) {
-        [self cleanupTables];
+    NSArray *rows = [db select:SelectStaleEncodings parameters:@[@(lastID), @(codec.identifier), @(CacheReencodeBatchSize)] error:NULL];
+    if (rows.count == 0) return nil;
+
+    [db withTransaction:^{
+      for (NSArray *row in rows) {
+        NSDictionary *value = [FNCacheCodecWithID((FNCacheCodecID)[row[2] intValue]) decode:row[1]];
+        NSData *data = value ? [codec encode:value] : nil;
+
+        // Rows that cannot be converted keep their old encoding; the
+        // UPDATE skips any a write replaced since the select.
+        if (data) {
+          [db execute:UpdateEncoding parameters:@[data, @(codec.identifier), @(data.length + CacheRowOverhead), row[0], row[2]] error:NULL];
+        }
       }
-    } onError:^(NSError *error) {
-      NSLog(@"Error cleaning up cache tables: %@", error);
+
+      return YES;
     }];
-  }
+
+    return rows.lastObject[0];
+  }];
+
+  // Continue straight from the writer rather than hopping through the main
+  // thread between batches.
+  [rv onCompletion:^(FNFuture *result) {
+    NSNumber *last = result.value;
+    if (!result.isError && last) [self reencodeAfter:last.longLongValue codec:codec];
+  } on:[FNInlineExecutor sharedExecutor]];
 }
 
 @end
@@ -20,18 +20,109 @@
 
 @class FNFuture;
 
+FOUNDATION_EXPORT NSTimeInterval const FNSQLiteDefaultBusyTimeout;
+FOUNDATION_EXPORT NSUInteger const FNSQLiteDefaultMaxBusyRetries;
+
+/*!
+ Steps through the rows of a query one at a time, reading columns in place. Values returned by the accessors are only valid for the current row. The cursor holds its statement until it reaches the last row or is closed, and must not outlive its connection.
+ */
+@interface FNSQLiteCursor : NSObject
+
+/*!
+ Set if stepping failed. next returns NO in that case too.
+ */
+@property (nonatomic, readonly) NSError *error;
+
+/*!
+ Advances to the next row, returning NO once there are no more rows or on error.
+ */
+- (BOOL)next;
+
+- (int)columnCount;
+
+- (BOOL)isNullAt:(int)column;
+
+- (int64_t)int64At:(int)column;
+
+- (double)doubleAt:(int)column;
+
+- (NSString *)textAt:(int)column;
+
+/*!
+ Returns the blob in the column without copying it. The data is only valid until the cursor moves or is closed.
+ */
+- (NSData *)blobNoCopyAt:(int)column;
+
+/*!
+ Returns the column boxed as an NSNumber, NSString or NSData, or nil for NULL.
+ */
+- (id)objectAt:(int)column;
+
+/*!
+ Releases the statement. Cursors close themselves after the last row and when deallocated.
+ */
+- (void)close;
+
+@end
+
 @interface FNSQLiteConnection : NSObject
 
 @property (readonly) BOOL isClosed;
 
+/*!
+ The number of prepared statements kept for reuse, keyed by SQL text and evicted least recently used first. Registered statements do not count against it. 0 disables the cache. Defaults to 32.
+ */
+@property (nonatomic) NSUInteger statementCacheSize;
+
+/*!
+ The number of statements served from the cache, and the number prepared from scratch.
+ */
+@property (nonatomic, readonly) NSUInteger statementCacheHits;
+@property (nonatomic, readonly) NSUInteger statementCacheMisses;
+
+/*!
+ How long, in seconds, SQLite itself waits on a lock before reporting the database busy. Each retry waits this long again before backing off, so it defaults to 0, leaving waiting to the retries; set it when maxBusyRetries is 0.
+ */
+@property (nonatomic) NSTimeInterval busyTimeout;
+
+/*!
+ How many times a busy or locked statement is retried, with exponential backoff and jitter, before failing with FNDatabaseBusy. Defaults to 8.
+ */
+@property (nonatomic) NSUInteger maxBusyRetries;
+
+/*!
+ The number of times a statement found the database busy or locked.
+ */
+@property (nonatomic, readonly) NSUInteger contentionCount;
+
 - (id)initWithSQLitePath:(NSString *)path;
 
+/*!
+ Opens the database at path, creating it unless readOnly is set.
+ */
+- (id)initWithSQLitePath:(NSString *)path readOnly:(BOOL)readOnly;
+
 - (BOOL)withTransaction:(BOOL(^)(void))block;
 
+/*!
+ Runs the block in a savepoint, rolling back its changes alone if it returns NO. Savepoints nest inside transactions and each other.
+ */
+- (BOOL)withSavepoint:(BOOL(^)(void))block;
+
+/*!
+ Prepares a statement and keeps it until the connection is closed, regardless of statementCacheSize. Use for statements on hot paths.
+ */
+- (BOOL)registerStatement:(NSString *)sql error:(NSError * __autoreleasing *)error;
+
 - (NSArray *)select:(NSString *)sql parameters:(NSArray *)parameters error:(NSError * __autoreleasing *)error;
 
 - (NSArray *)select:(NSString *)sql error:(NSError * __autoreleasing *)error;
 
+/*!
+ Returns a cursor over the rows of the query, or nil on error.
+ */
+- (FNSQLiteCursor *)query:(NSString *)sql parameters:(NSArray *)parameters error:(NSError * __autoreleasing *)error;
+
 - (BOOL)execute:(NSString *)sql parameters:(NSArray *)parameters error:(NSError * __autoreleasing *)error;
 
 - (BOOL)execute:(NSString *)sql error:(NSError * __autoreleasing *)error;
@@ -19,26 +19,168 @@
 #import "FNError.h"
 #import "FNSQLiteConnection.h"
 
+#define FNSQLiteDefaultStatementCacheSize 32
+#define FNSQLiteBackoffBase 0.001
+#define FNSQLiteBackoffMax 0.1
+
 typedef int SQLITE_STATUS;
 
+NSTimeInterval const FNSQLiteDefaultBusyTimeout = 0;
+NSUInteger const FNSQLiteDefaultMaxBusyRetries = 8;
+
 static NSError * SQLiteError(int status, const char *msg) {
+  if (status == SQLITE_BUSY || status == SQLITE_LOCKED) return FNDatabaseBusy();
+
   return [NSError errorWithDomain:@"org.fauna.FNCache" code:3 userInfo:@{
           @"sqlite_status_code": @(status),
           @"sqlite_error_message": [NSString stringWithCString:msg encoding:NSUTF8StringEncoding]
           }];
 }
 
+@interface FNSQLiteStatement : NSObject
+
+@property (nonatomic, readonly) sqlite3_stmt *stmt;
+@property (nonatomic) BOOL isInUse;
+@property (nonatomic) BOOL isCached;
+@property (nonatomic) BOOL isRegistered;
+
+- (id)initWithStatement:(sqlite3_stmt *)stmt;
+
+- (void)close;
+
+@end
+
+@implementation FNSQLiteStatement
+
+- (id)initWithStatement:(sqlite3_stmt *)stmt {
+  if (self = [super init]) {
+    _stmt = stmt;
+  }
+  return self;
+}
+
+- (void)dealloc {
+  [self close];
+}
+
+- (void)close {
+  if (_stmt) sqlite3_finalize(_stmt);
+  _stmt = NULL;
+}
+
+@end
+
 @interface FNSQLiteConnection ()
 
 @property (nonatomic, readonly) sqlite3 *database;
+@property (nonatomic, readonly) NSMutableDictionary *statements;
+@property (nonatomic, readonly) NSMutableArray *recentStatements;
+
+- (SQLITE_STATUS)step:(sqlite3_stmt *)stmt;
+
+- (SQLITE_STATUS)checkinStatement:(FNSQLiteStatement *)statement;
+
+@end
+
+@interface FNSQLiteCursor () {
+  FNSQLiteConnection *_connection;
+  FNSQLiteStatement *_statement;
+  sqlite3_stmt *_stmt;
+}
+
+- (id)initWithConnection:(FNSQLiteConnection *)connection statement:(FNSQLiteStatement *)statement;
+
+@end
+
+@implementation FNSQLiteCursor
+
+- (id)initWithConnection:(FNSQLiteConnection *)connection statement:(FNSQLiteStatement *)statement {
+  if (self = [super init]) {
+    _connection = connection;
+    _statement = statement;
+    _stmt = statement.stmt;
+  }
+  return self;
+}
+
+- (void)dealloc {
+  [self close];
+}
+
+- (BOOL)next {
+  if (!_statement) return NO;
+
+  SQLITE_STATUS status = [_connection step:_stmt];
+  if (status == SQLITE_ROW) return YES;
+
+  if (status != SQLITE_DONE) _error = SQLiteError(status, sqlite3_errmsg(_connection.database));
+  [self close];
+  return NO;
+}
+
+- (void)close {
+  if (!_statement) return;
+
+  [_connection checkinStatement:_statement];
+  _statement = nil;
+  _stmt = NULL;
+}
+
+- (int)columnCount {
+  return sqlite3_column_count(_stmt);
+}
+
+- (BOOL)isNullAt:(int)column {
+  return sqlite3_column_type(_stmt, column) == SQLITE_NULL;
+}
+
+- (int64_t)int64At:(int)column {
+  return sqlite3_column_int64(_stmt, column);
+}
+
+- (double)doubleAt:(int)column {
+  return sqlite3_column_double(_stmt, column);
+}
+
+- (NSString *)textAt:(int)column {
+  const char *text = (const char *)sqlite3_column_text(_stmt, column);
+  return text ? [NSString stringWithUTF8String:text] : nil;
+}
+
+- (NSData *)blobNoCopyAt:(int)column {
+  const void *bytes = sqlite3_column_blob(_stmt, column);
+  if (!bytes) return nil;
+
+  return [NSData dataWithBytesNoCopy:(void *)bytes length:sqlite3_column_bytes(_stmt, column) freeWhenDone:NO];
+}
+
+- (id)objectAt:(int)column {
+  switch (sqlite3_column_type(_stmt, column)) {
+    case SQLITE_INTEGER:
+      return @(sqlite3_column_int64(_stmt, column));
+    case SQLITE_FLOAT:
+      return @(sqlite3_column_double(_stmt, column));
+    case SQLITE_TEXT:
+      return [self textAt:column];
+    case SQLITE_BLOB:
+      return [NSData dataWithBytes:sqlite3_column_blob(_stmt, column) length:sqlite3_column_bytes(_stmt, column)];
+    default:
+      return nil;
+  }
+}
 
 @end
 
 @implementation FNSQLiteConnection
 
 - (id)initWithSQLitePath:(NSString *)path {
+  return [self initWithSQLitePath:path readOnly:NO];
+}
+
+- (id)initWithSQLitePath:(NSString *)path readOnly:(BOOL)readOnly {
   if(self = [super init]) {
-    SQLITE_STATUS status = sqlite3_open([path fileSystemRepresentation], &_database);
+    int flags = readOnly ? SQLITE_OPEN_READONLY : SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
+    SQLITE_STATUS status = sqlite3_open_v2([path fileSystemRepresentation], &_database, flags, NULL);
     if(status != SQLITE_OK) {
       const char *errMsg;
       if (_database) {
@@ -52,6 +194,11 @@ static NSError * SQLiteError(int status, const char *msg) {
     }
 
     _isClosed = NO;
+    _statementCacheSize = FNSQLiteDefaultStatementCacheSize;
+    _statements = [NSMutableDictionary new];
+    _recentStatements = [NSMutableArray new];
+    _maxBusyRetries = FNSQLiteDefaultMaxBusyRetries;
+    self.busyTimeout = FNSQLiteDefaultBusyTimeout;
   }
 
   return self;
@@ -68,8 +215,7 @@ static NSError * SQLiteError(int status, const char *msg) {
 
   [self execute:@"BEGIN" error:&err];
 
-  if (block()) {
-    [self execute:@"COMMIT" error:&err];
+  if (block() && [self execute:@"COMMIT" error:&err]) {
     return YES;
   } else {
     [self execute:@"ROLLBACK" error:&err];
@@ -77,16 +223,17 @@ static NSError * SQLiteError(int status, const char *msg) {
   }
 }
 
-static SQLITE_STATUS step(sqlite3_stmt *stmt) {
-  int status = sqlite3_step(stmt);
+- (BOOL)withSavepoint:(BOOL(^)(void))block {
+  NSError __autoreleasing *err;
+
+  if (![self execute:@"SAVEPOINT fn_savepoint" error:&err]) return NO;
 
-  if (status == SQLITE_BUSY || status == SQLITE_LOCKED) {
-    // TODO: Backoff
-    // [self performSelector:@selector(executeNextStep:) withObject:(__bridge id)stmt afterDelay:.005];
-    usleep(5000);
-    return step(stmt);
+  if (block()) {
+    return [self execute:@"RELEASE fn_savepoint" error:&err];
   } else {
-    return status;
+    [self execute:@"ROLLBACK TO fn_savepoint" error:&err];
+    [self execute:@"RELEASE fn_savepoint" error:&err];
+    return NO;
   }
 }
 
@@ -131,67 +278,49 @@ static int BindParameters(sqlite3_stmt *stmt, NSArray *parameters) {
 }
 
 - (NSArray *)select:(NSString *)sql parameters:(NSArray *)parameters error:(NSError * __autoreleasing *)error {
-  NSAssert(!self.isClosed, @"Database is closed.");
+  FNSQLiteCursor *cursor = [self query:sql parameters:parameters error:error];
+  if (!cursor) return nil;
 
-  sqlite3_stmt *stmt;
-  int status = sqlite3_prepare_v2(self.database, [sql UTF8String], -1, &stmt, NULL);
+  NSMutableArray *result = [NSMutableArray new];
+  int cols = cursor.columnCount;
 
-  if (status != SQLITE_OK) {
-    *error = SQLiteError(status, sqlite3_errmsg(self.database));
-    return nil;
-  }
+  while ([cursor next]) {
+    NSMutableArray *row = [[NSMutableArray alloc] initWithCapacity:cols];
 
-  status = BindParameters(stmt, parameters);
+    for (int i = 0; i < cols; i++) {
+      id value = [cursor objectAt:i];
+      if (value) [row addObject:value];
+    }
 
-  if (status != SQLITE_OK) {
-    sqlite3_finalize(stmt);
-    *error = SQLiteError(status, sqlite3_errmsg(self.database));
-    return nil;
+    [result addObject:row];
   }
 
-  status = step(stmt);
+  NSError *err = cursor.error;
+  [cursor close];
 
-  NSMutableArray *result = [NSMutableArray new];
+  if (err) {
+    if (error) *error = err;
+    return nil;
+  } else {
+    return result;
+  }
+}
 
-  if (status == SQLITE_ROW) {
-    int cols = sqlite3_column_count(stmt);
-
-    do {
-      NSMutableArray *row = [[NSMutableArray alloc] initWithCapacity:cols];
-
-      for(int i = 0; i < cols; i++) {
-        switch (sqlite3_column_type(stmt, i)) {
-          case SQLITE_INTEGER:
-            [row addObject:@(sqlite3_column_int64(stmt, i))];
-            break;
-          case SQLITE_FLOAT:
-            [row addObject:@(sqlite3_column_double(stmt, i))];
-            break;
-          case SQLITE_TEXT:
-            [row addObject:[NSString stringWithCString:(const char *)sqlite3_column_text(stmt, i)
-                                              encoding:NSUTF8StringEncoding]];
-            break;
-          case SQLITE_BLOB:
-            [row addObject:[NSData dataWithBytes:sqlite3_column_blob(stmt, i)
-                                          length:sqlite3_column_bytes(stmt, i)]];
-            break;
-        }
-      }
+- (FNSQLiteCursor *)query:(NSString *)sql parameters:(NSArray *)parameters error:(NSError * __autoreleasing *)error {
+  NSAssert(!self.isClosed, @"Database is closed.");
 
-      [result addObject:row];
-      
-      status = step(stmt);
-    } while (status == SQLITE_ROW);
-  }
+  FNSQLiteStatement *statement = [self checkoutStatement:sql error:error];
+  if (!statement) return nil;
 
-  status = sqlite3_finalize(stmt);
+  int status = BindParameters(statement.stmt, parameters);
 
-  if (status == SQLITE_DONE || status == SQLITE_OK) {
-    return result;
-  } else {
-    *error = SQLiteError(status, sqlite3_errmsg(self.database));
+  if (status != SQLITE_OK) {
+    [self checkinStatement:statement];
+    if (error) *error = SQLiteError(status, sqlite3_errmsg(self.database));
     return nil;
   }
+
+  return [[FNSQLiteCursor alloc] initWithConnection:self statement:statement];
 }
 
 - (BOOL)execute:(NSString *)sql error:(NSError *__autoreleasing *)error {
@@ -201,30 +330,25 @@ static int BindParameters(sqlite3_stmt *stmt, NSArray *parameters) {
 - (BOOL)execute:(NSString *)sql parameters:(NSArray *)parameters error:(NSError * __autoreleasing *)error {
   NSAssert(!self.isClosed, @"Database is closed.");
 
-  sqlite3_stmt *stmt;
-  int status = sqlite3_prepare_v2(self.database, [sql UTF8String], -1, &stmt, NULL);
-
-  if (status != SQLITE_OK) {
-    *error = SQLiteError(status, sqlite3_errmsg(self.database));
-    return nil;
-  }
+  FNSQLiteStatement *statement = [self checkoutStatement:sql error:error];
+  if (!statement) return NO;
 
-  status = BindParameters(stmt, parameters);
+  int status = BindParameters(statement.stmt, parameters);
 
   if (status != SQLITE_OK) {
-    sqlite3_finalize(stmt);
-    *error = SQLiteError(status, sqlite3_errmsg(self.database));
-    return nil;
+    [self checkinStatement:statement];
+    if (error) *error = SQLiteError(status, sqlite3_errmsg(self.database));
+    return NO;
   }
 
-  status = step(stmt);
-
-  sqlite3_finalize(stmt);
+  status = [self step:statement.stmt];
 
   if (status == SQLITE_DONE || status == SQLITE_ROW || status == SQLITE_OK) {
+    [self checkinStatement:statement];
     return YES;
   } else {
-    *error = SQLiteError(status, sqlite3_errmsg(self.database));
+    if (error) *error = SQLiteError(status, sqlite3_errmsg(self.database));
+    [self checkinStatement:statement];
     return NO;
   }
 }
@@ -242,9 +366,136 @@ static int BindParameters(sqlite3_stmt *stmt, NSArray *parameters) {
   return msg == NULL ? nil : [NSString stringWithCString:msg encoding:NSUTF8StringEncoding];
 }
 
+- (BOOL)registerStatement:(NSString *)sql error:(NSError * __autoreleasing *)error {
+  NSAssert(!self.isClosed, @"Database is closed.");
+
+  FNSQLiteStatement *statement = self.statements[sql];
+
+  if (!statement) {
+    statement = [self prepareStatement:sql error:error];
+    if (!statement) return NO;
+
+    statement.isCached = YES;
+    self.statements[sql] = statement;
+  }
+
+  statement.isRegistered = YES;
+  [self.recentStatements removeObject:sql];
+
+  return YES;
+}
+
 - (void)close {
+  if (_isClosed) return;
+
   _isClosed = YES;
+
+  // Statements must be finalized before the handle will close.
+  for (FNSQLiteStatement *statement in self.statements.allValues) {
+    [statement close];
+  }
+
+  [self.statements removeAllObjects];
+  [self.recentStatements removeAllObjects];
+
   sqlite3_close(self.database);
 }
 
+#pragma mark Private methods
+
+// Retries busy or locked steps after sleeping for a random interval of up to
+// twice the last one, so contending connections spread out.
+- (SQLITE_STATUS)step:(sqlite3_stmt *)stmt {
+  NSTimeInterval backoff = FNSQLiteBackoffBase;
+
+  for (NSUInteger retries = 0; ; retries++) {
+    SQLITE_STATUS status = sqlite3_step(stmt);
+
+    if (status != SQLITE_BUSY && status != SQLITE_LOCKED) return status;
+
+    _contentionCount++;
+
+    if (retries >= self.maxBusyRetries) return status;
+
+    NSTimeInterval delay = backoff / 2 + (backoff / 2) * arc4random_uniform(1001) / 1000.0;
+    usleep((useconds_t)(delay * USEC_PER_SEC));
+    backoff = MIN(backoff * 2, FNSQLiteBackoffMax);
+  }
+}
+
+- (void)setBusyTimeout:(NSTimeInterval)busyTimeout {
+  _busyTimeout = busyTimeout;
+  sqlite3_busy_timeout(self.database, (int)(busyTimeout * 1000));
+}
+
+- (FNSQLiteStatement *)prepareStatement:(NSString *)sql error:(NSError * __autoreleasing *)error {
+  sqlite3_stmt *stmt;
+  int status = sqlite3_prepare_v2(self.database, [sql UTF8String], -1, &stmt, NULL);
+
+  if (status != SQLITE_OK) {
+    if (error) *error = SQLiteError(status, sqlite3_errmsg(self.database));
+    return nil;
+  }
+
+  return [[FNSQLiteStatement alloc] initWithStatement:stmt];
+}
+
+- (FNSQLiteStatement *)checkoutStatement:(NSString *)sql error:(NSError * __autoreleasing *)error {
+  FNSQLiteStatement *statement = self.statements[sql];
+
+  if (statement && !statement.isInUse) {
+    _statementCacheHits++;
+
+    if (!statement.isRegistered) {
+      [self.recentStatements removeObject:sql];
+      [self.recentStatements addObject:sql];
+    }
+  } else {
+    _statementCacheMisses++;
+
+    statement = [self prepareStatement:sql error:error];
+    if (!statement) return nil;
+
+    // If the cached copy is checked out (a nested use), this one is left
+    // uncached and finalized when it is checked back in.
+    if (!self.statements[sql] && self.statementCacheSize > 0) {
+      statement.isCached = YES;
+      self.statements[sql] = statement;
+      [self.recentStatements addObject:sql];
+      [self evictStatements];
+    }
+  }
+
+  statement.isInUse = YES;
+  return statement;
+}
+
+- (SQLITE_STATUS)checkinStatement:(FNSQLiteStatement *)statement {
+  SQLITE_STATUS status = sqlite3_reset(statement.stmt);
+  sqlite3_clear_bindings(statement.stmt);
+
+  statement.isInUse = NO;
+  if (!statement.isCached) [statement close];
+
+  return status;
+}
+
+- (void)evictStatements {
+  while (self.recentStatements.count > self.statementCacheSize) {
+    NSString *sql = self.recentStatements[0];
+    FNSQLiteStatement *statement = self.statements[sql];
+
+    [self.recentStatements removeObjectAtIndex:0];
+    [self.statements removeObjectForKey:sql];
+
+    statement.isCached = NO;
+    if (!statement.isInUse) [statement close];
+  }
+}
+
+- (void)setStatementCacheSize:(NSUInteger)statementCacheSize {
+  _statementCacheSize = statementCacheSize;
+  [self evictStatements];
+}
+
 @end
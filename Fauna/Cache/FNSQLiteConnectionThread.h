@@ -23,10 +23,21 @@
 
 @interface FNSQLiteConnectionThread: NSObject
 
+/*!
+ Forwarded to the connection; see FNSQLiteConnection.
+ */
+@property (nonatomic) NSTimeInterval busyTimeout;
+@property (nonatomic) NSUInteger maxBusyRetries;
+
 - (id)initWithSQLitePath:(NSString *)path;
 
 - (FNFuture *)withConnection:(id(^)(FNSQLiteConnection *db))block;
 
 - (void)close;
 
+/*!
+ The number of times statements run through withConnection: found the database busy or locked. Safe to read from any thread.
+ */
+- (NSUInteger)contentionCount;
+
 @end
@@ -22,22 +22,120 @@
 #import "NSThread+FNFutureOperations.h"
 #import "FNSQLiteConnectionThread.h"
 
+#define FNSQLiteWorkerThreadCount 4
+
+// Connections are confined to one of a fixed set of threads shared by every
+// connection in the process, rather than each getting its own. Blocks for
+// connections sharing a thread run serially, like blocks for one connection.
+@interface FNSQLiteWorker : NSObject
+
+@property (nonatomic, readonly) NSThread *thread;
+@property (nonatomic) NSUInteger connections;
+
++ (FNSQLiteWorker *)checkout;
+
++ (void)checkin:(FNSQLiteWorker *)worker;
+
+@end
+
+@implementation FNSQLiteWorker
+
+static NSMutableArray *FNSQLiteWorkers;
+
+- (id)init {
+  if (self = [super init]) {
+    _thread = [[NSThread alloc] initWithTarget:[FNSQLiteWorker class] selector:@selector(threadLoop) object:nil];
+    _thread.name = @"org.fauna.FNSQLiteWorker";
+    [_thread start];
+  }
+  return self;
+}
+
++ (void)threadLoop {
+  NSRunLoop *loop = [NSRunLoop currentRunLoop];
+
+  // Without a source the run loop returns at once instead of waiting for
+  // performed blocks.
+  [loop addPort:[NSPort port] forMode:NSDefaultRunLoopMode];
+
+  while (YES) {
+    @autoreleasepool {
+      [loop runMode:NSDefaultRunLoopMode beforeDate:[NSDate distantFuture]];
+    }
+  }
+}
+
+// Threads are started as needed up to the limit, then shared by load.
++ (FNSQLiteWorker *)checkout {
+  @synchronized (self) {
+    if (!FNSQLiteWorkers) FNSQLiteWorkers = [NSMutableArray new];
+
+    FNSQLiteWorker *worker = nil;
+
+    for (FNSQLiteWorker *w in FNSQLiteWorkers) {
+      if (!worker || w.connections < worker.connections) worker = w;
+    }
+
+    if (!worker || (worker.connections > 0 && FNSQLiteWorkers.count < FNSQLiteWorkerThreadCount)) {
+      worker = [FNSQLiteWorker new];
+      [FNSQLiteWorkers addObject:worker];
+    }
+
+    worker.connections++;
+    return worker;
+  }
+}
+
++ (void)checkin:(FNSQLiteWorker *)worker {
+  @synchronized (self) {
+    worker.connections--;
+  }
+}
+
+@end
+
+static NSError * ConnectionClosedError() {
+  return [NSError errorWithDomain:@"blah" code:42 userInfo:@{@"msg": @"thread has been cancelled"}];
+}
+
+static NSError * ConnectionOpenError(NSString *path) {
+  return [NSError errorWithDomain:@"org.fauna.FNCache" code:5 userInfo:@{@"msg": [NSString stringWithFormat:@"could not open database %@", path]}];
+}
+
 @interface FNSQLiteConnectionThread ()
 
-@property (nonatomic, readonly) FNSQLiteConnection *connection;
+@property (nonatomic, readonly) FNSQLiteWorker *worker;
 @property (nonatomic, readonly) NSThread *thread;
 
+// Only touched on the worker thread.
+@property (nonatomic) FNSQLiteConnection *connection;
+@property (nonatomic) NSError *openError;
+
+// Guarded by @synchronized (self).
+@property (nonatomic) BOOL isClosed;
+
 @end
 
-@implementation FNSQLiteConnectionThread
+@implementation FNSQLiteConnectionThread {
+  int64_t volatile _contentionCount;
+}
 
 #pragma mark lifecycle
 
 - (id)initWithSQLitePath:(NSString *)path {
   if(self = [super init]) {
-    _connection = [[FNSQLiteConnection alloc] initWithSQLitePath:path];
-    _thread = [[NSThread alloc] initWithTarget:self selector:@selector(threadLoop) object:nil];
-    [_thread start];
+    _worker = [FNSQLiteWorker checkout];
+    _thread = _worker.thread;
+    _busyTimeout = FNSQLiteDefaultBusyTimeout;
+    _maxBusyRetries = FNSQLiteDefaultMaxBusyRetries;
+
+    // Opening touches the disk, so it happens on the worker rather than on
+    // the thread creating us. Later blocks queue up behind it.
+    [_thread performBlock:^id{
+      self.connection = [[FNSQLiteConnection alloc] initWithSQLitePath:path];
+      if (!self.connection) self.openError = ConnectionOpenError(path);
+      return nil;
+    }];
   }
 
   return self;
@@ -45,36 +143,61 @@
 
 #pragma mark Public methods
 
-- (void)close {
+// The connection is confined to the worker, so settings are applied there,
+// in order behind the open.
+- (void)setBusyTimeout:(NSTimeInterval)busyTimeout {
+  _busyTimeout = busyTimeout;
+
   [self.thread performBlock:^id{
-    [self.connection close];
+    if (!self.connection.isClosed) self.connection.busyTimeout = busyTimeout;
     return nil;
   }];
 }
 
-#pragma mark Private methods
+- (void)setMaxBusyRetries:(NSUInteger)maxBusyRetries {
+  _maxBusyRetries = maxBusyRetries;
 
+  [self.thread performBlock:^id{
+    if (!self.connection.isClosed) self.connection.maxBusyRetries = maxBusyRetries;
+    return nil;
+  }];
+}
 
-- (void)threadLoop {
-  while (!self.connection.isClosed) {
-    @autoreleasepool {
-      [[NSRunLoop currentRunLoop] run];
-    }
+- (void)close {
+  @synchronized (self) {
+    if (self.isClosed) return;
+    self.isClosed = YES;
   }
+
+  [self.thread performBlock:^id{
+    [self.connection close];
+    [FNSQLiteWorker checkin:self.worker];
+    return nil;
+  }];
 }
 
 - (FNFuture *)withConnection:(id(^)(FNSQLiteConnection *db))block {
-  if (!self.connection.isClosed) {
-    return [self.thread performBlock:^{
-      if (!self.connection.isClosed) {
-        return block(self.connection);
-      } else {
-        return [NSError errorWithDomain:@"blah" code:42 userInfo:@{@"msg": @"thread has been cancelled"}];
-      }
-    }];
-  } else {
-    return [FNFuture error:[NSError errorWithDomain:@"blah" code:42 userInfo:@{@"msg": @"thread has been cancelled"}]];
+  @synchronized (self) {
+    if (self.isClosed) return [FNFuture error:ConnectionClosedError()];
   }
+
+  return [self.thread performBlock:^{
+    if (self.openError) return (id)self.openError;
+    if (self.connection.isClosed) return (id)ConnectionClosedError();
+
+    FNSQLiteConnection *db = self.connection;
+    NSUInteger contention = db.contentionCount;
+
+    @try {
+      return block(db);
+    } @finally {
+      __sync_add_and_fetch(&_contentionCount, (int64_t)(db.contentionCount - contention));
+    }
+  }];
+}
+
+- (NSUInteger)contentionCount {
+  return (NSUInteger)__sync_add_and_fetch(&_contentionCount, 0);
 }
 
 @end
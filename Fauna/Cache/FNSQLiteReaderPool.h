@@ -0,0 +1,50 @@
+//
+// FNSQLiteReaderPool.h
+//
+// Copyright (c) 2013 Fauna, Inc.
+//
+// Licensed under the Mozilla Public License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain a
+// copy of the License at
+//
+// http://mozilla.org/MPL/2.0/
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+@class FNFuture;
+@class FNSQLiteConnection;
+
+/*!
+ A pool of read-only connections to a database in WAL mode, so reads run concurrently with each other and with the writer. Blocks from every pool run on one shared queue of 4 threads. Connections are opened as needed, and up to size are kept open between blocks.
+ */
+@interface FNSQLiteReaderPool : NSObject
+
+@property (nonatomic, readonly) NSUInteger size;
+
+/*!
+ Applied to each connection as a block checks it out; see FNSQLiteConnection.
+ */
+@property (atomic) NSTimeInterval busyTimeout;
+@property (atomic) NSUInteger maxBusyRetries;
+
+- (id)initWithSQLitePath:(NSString *)path size:(NSUInteger)size;
+
+/*!
+ Runs the block on a background thread with a connection to itself. The block must not write.
+ */
+- (FNFuture *)withConnection:(id(^)(FNSQLiteConnection *db))block;
+
+/*!
+ The number of times statements on the pool's connections found the database busy or locked. Safe to read from any thread.
+ */
+- (NSUInteger)contentionCount;
+
+- (void)close;
+
+@end
@@ -0,0 +1,142 @@
+//
+// FNSQLiteReaderPool.m
+//
+// Copyright (c) 2013 Fauna, Inc.
+//
+// Licensed under the Mozilla Public License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain a
+// copy of the License at
+//
+// http://mozilla.org/MPL/2.0/
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+//
+
+#import "FNFuture.h"
+#import "FNSQLiteConnection.h"
+#import "NSOperationQueue+FNFutureOperations.h"
+#import "FNSQLiteReaderPool.h"
+
+#define FNSQLiteReaderThreadCount 4
+
+// Reads from every pool share one bounded queue, like the writers share their
+// worker threads, so the number of reader threads does not grow with the
+// number of open caches.
+static NSOperationQueue * SharedReaderQueue(void) {
+  static NSOperationQueue *queue;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    queue = [NSOperationQueue new];
+    queue.name = @"org.fauna.FNSQLiteReader";
+    queue.maxConcurrentOperationCount = FNSQLiteReaderThreadCount;
+  });
+
+  return queue;
+}
+
+static NSError * ReaderUnavailableError() {
+  return [NSError errorWithDomain:@"org.fauna.FNCache" code:4 userInfo:@{@"msg": @"reader connection is closed or could not be opened"}];
+}
+
+@interface FNSQLiteReaderPool ()
+
+@property (nonatomic, readonly) NSString *path;
+@property (nonatomic, readonly) NSMutableArray *idle;
+@property (nonatomic) BOOL isClosed;
+
+@end
+
+@implementation FNSQLiteReaderPool {
+  int64_t volatile _contentionCount;
+}
+
+#pragma mark lifecycle
+
+- (id)initWithSQLitePath:(NSString *)path size:(NSUInteger)size {
+  if (self = [super init]) {
+    _path = path;
+    _size = size;
+    _busyTimeout = FNSQLiteDefaultBusyTimeout;
+    _maxBusyRetries = FNSQLiteDefaultMaxBusyRetries;
+    _idle = [NSMutableArray new];
+  }
+
+  return self;
+}
+
+- (void)dealloc {
+  [self close];
+}
+
+#pragma mark Public methods
+
+- (FNFuture *)withConnection:(id(^)(FNSQLiteConnection *db))block {
+  if (self.isClosed) return [FNFuture error:ReaderUnavailableError()];
+
+  return [SharedReaderQueue() futureOperationWithBlock:^id{
+    FNSQLiteConnection *db = [self checkoutConnection];
+    if (!db) return ReaderUnavailableError();
+
+    db.busyTimeout = self.busyTimeout;
+    db.maxBusyRetries = self.maxBusyRetries;
+
+    NSUInteger contention = db.contentionCount;
+
+    @try {
+      return block(db);
+    } @finally {
+      __sync_add_and_fetch(&_contentionCount, (int64_t)(db.contentionCount - contention));
+      [self checkinConnection:db];
+    }
+  }];
+}
+
+- (NSUInteger)contentionCount {
+  return (NSUInteger)__sync_add_and_fetch(&_contentionCount, 0);
+}
+
+- (void)close {
+  @synchronized (self.idle) {
+    self.isClosed = YES;
+
+    for (FNSQLiteConnection *db in self.idle) {
+      [db close];
+    }
+
+    [self.idle removeAllObjects];
+  }
+}
+
+#pragma mark Private methods
+
+- (FNSQLiteConnection *)checkoutConnection {
+  @synchronized (self.idle) {
+    if (self.isClosed) return nil;
+
+    FNSQLiteConnection *db = self.idle.lastObject;
+
+    if (db) {
+      [self.idle removeLastObject];
+      return db;
+    }
+  }
+
+  return [[FNSQLiteConnection alloc] initWithSQLitePath:self.path readOnly:YES];
+}
+
+- (void)checkinConnection:(FNSQLiteConnection *)db {
+  @synchronized (self.idle) {
+    // Blocks beyond size that ran at once opened extra connections; only
+    // size are kept.
+    if (self.isClosed || self.idle.count >= self.size) {
+      [db close];
+    } else {
+      [self.idle addObject:db];
+    }
+  }
+}
+
+@end
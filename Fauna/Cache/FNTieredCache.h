@@ -0,0 +1,40 @@
+//
+// FNTieredCache.h
+//
+// Copyright (c) 2013 Fauna, Inc.
+//
+// Licensed under the Mozilla Public License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain a
+// copy of the License at
+//
+// http://mozilla.org/MPL/2.0/
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+#import "FNCache.h"
+
+/*!
+ A bounded in-memory LRU of decoded resources in front of another cache. Writes go to both tiers; reads that hit memory return already completed futures without leaving the calling thread, and misses are filled from the backing cache.
+ */
+@interface FNTieredCache : FNCache
+
+@property (nonatomic, readonly) FNCache *backingCache;
+
+/*!
+ Approximate bytes of resources held in memory.
+ */
+@property (nonatomic, readonly) NSUInteger maxSize;
+
+- (id)initWithBackingCache:(FNCache *)cache maxSize:(NSUInteger)maxSize;
+
+/*!
+ Drops everything held in memory. The backing cache is untouched.
+ */
+- (void)removeAllMemoryObjects;
+
+@end
@@ -0,0 +1,371 @@
+//
+// FNTieredCache.m
+//
+// Copyright (c) 2013 Fauna, Inc.
+//
+// Licensed under the Mozilla Public License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain a
+// copy of the License at
+//
+// http://mozilla.org/MPL/2.0/
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+//
+
+#import <pthread.h>
+#import "FNTieredCache.h"
+#import "FNFuture.h"
+
+#define EntryOverhead 64
+
+// Rough heap footprint of a decoded JSON value, used to bound the tier.
+static NSUInteger EstimatedSize(id value) {
+  if ([value isKindOfClass:[NSString class]]) {
+    return 16 + [value length] * 2;
+  } else if ([value isKindOfClass:[NSDictionary class]]) {
+    NSUInteger size = 32;
+    for (id key in value) size += EstimatedSize(key) + EstimatedSize(value[key]);
+    return size;
+  } else if ([value isKindOfClass:[NSArray class]]) {
+    NSUInteger size = 32;
+    for (id elem in value) size += EstimatedSize(elem);
+    return size;
+  } else {
+    return 16;
+  }
+}
+
+// Copies nested containers too, so neither the writer nor readers handed the
+// held value can change it after insertion.
+static id ImmutableCopy(id value) {
+  if ([value isKindOfClass:[NSDictionary class]]) {
+    NSMutableDictionary *rv = [NSMutableDictionary dictionaryWithCapacity:[value count]];
+
+    [value enumerateKeysAndObjectsUsingBlock:^(id key, id obj, BOOL *stop) {
+      rv[key] = ImmutableCopy(obj);
+    }];
+
+    return [rv copy];
+  } else if ([value isKindOfClass:[NSArray class]]) {
+    NSMutableArray *rv = [NSMutableArray arrayWithCapacity:[value count]];
+    for (id obj in value) [rv addObject:ImmutableCopy(obj)];
+    return [rv copy];
+  } else {
+    return [value copy];
+  }
+}
+
+// The paths SQLite would alias a resource under besides any extra ones.
+static NSArray * DerivedPaths(NSDictionary *value) {
+  NSString *uniqueID = value[@"unique_id"];
+
+  if (uniqueID && value[@"class"]) {
+    return @[value[@"ref"], [value[@"class"] stringByAppendingFormat:@"/%@", uniqueID]];
+  } else {
+    return @[value[@"ref"]];
+  }
+}
+
+@interface FNTieredCacheEntry : NSObject
+
+@property (nonatomic, readonly) id value;
+@property (nonatomic, readonly) FNTimestamp timestamp;
+@property (nonatomic, readonly) NSArray *paths;
+@property (nonatomic, readonly) NSUInteger size;
+@property (nonatomic, unsafe_unretained) FNTieredCacheEntry *prev;
+@property (nonatomic) FNTieredCacheEntry *next;
+
+- (id)initWithValue:(id)value timestamp:(FNTimestamp)timestamp paths:(NSArray *)paths;
+
+@end
+
+@implementation FNTieredCacheEntry
+
+- (id)initWithValue:(id)value timestamp:(FNTimestamp)timestamp paths:(NSArray *)paths {
+  if (self = [super init]) {
+    _value = value;
+    _timestamp = timestamp;
+    _paths = paths;
+    _size = EntryOverhead + EstimatedSize(value) + EstimatedSize(paths);
+  }
+  return self;
+}
+
+@end
+
+@interface FNTieredCache () {
+  pthread_mutex_t _lock;
+  NSUInteger _size;
+  uint64_t _generation;
+}
+
+@property (nonatomic, readonly) NSMutableDictionary *entries;
+
+// Most recently used first. The list owns entries through next.
+@property (nonatomic) FNTieredCacheEntry *head;
+@property (nonatomic, unsafe_unretained) FNTieredCacheEntry *tail;
+
+@end
+
+@implementation FNTieredCache
+
+- (id)initWithBackingCache:(FNCache *)cache maxSize:(NSUInteger)maxSize {
+  if (self = [super init]) {
+    _backingCache = cache;
+    _maxSize = maxSize;
+    _entries = [NSMutableDictionary new];
+    pthread_mutex_init(&_lock, NULL);
+  }
+  return self;
+}
+
+- (void)dealloc {
+  // Unlink iteratively; releasing a long chain recursively could overflow.
+  while (_head) _head = _head.next;
+  pthread_mutex_destroy(&_lock);
+}
+
+- (void)removeAllMemoryObjects {
+  pthread_mutex_lock(&_lock);
+  while (self.head) [self unlink:self.head];
+  _generation++;
+  pthread_mutex_unlock(&_lock);
+}
+
+#pragma mark FNCache
+
+- (void)close {
+  [self removeAllMemoryObjects];
+  [self.backingCache close];
+}
+
+- (FNFuture *)objectForPath:(NSString *)path after:(FNTimestamp)after {
+  uint64_t generation;
+  FNTieredCacheEntry *entry = [self entryForPath:path after:after generation:&generation];
+
+  if (entry) return [FNFuture value:entry.value];
+
+  return [[self fillPath:path after:after generation:generation] map:^id(FNCachedObject *cached) {
+    return cached.value;
+  } on:[FNInlineExecutor sharedExecutor]];
+}
+
+- (FNFuture *)cachedObjectForPath:(NSString *)path after:(FNTimestamp)after {
+  uint64_t generation;
+  FNTieredCacheEntry *entry = [self entryForPath:path after:after generation:&generation];
+
+  if (entry) return [FNFuture value:[[FNCachedObject alloc] initWithValue:entry.value timestamp:entry.timestamp]];
+
+  return [self fillPath:path after:after generation:generation];
+}
+
+- (FNFuture *)objectsForPaths:(NSArray *)paths after:(FNTimestamp)after {
+  NSMutableDictionary *hits = [NSMutableDictionary dictionaryWithCapacity:paths.count];
+  NSMutableArray *misses = [NSMutableArray new];
+
+  pthread_mutex_lock(&_lock);
+
+  uint64_t generation = _generation;
+
+  for (NSString *path in paths) {
+    FNTieredCacheEntry *entry = self.entries[path];
+
+    if (entry && entry.timestamp >= after) {
+      [self moveToFront:entry];
+      hits[path] = entry.value;
+    } else {
+      [misses addObject:path];
+    }
+  }
+
+  pthread_mutex_unlock(&_lock);
+
+  if (misses.count == 0) return [FNFuture value:hits];
+
+  return [[self.backingCache objectsForPaths:misses after:after] map:^id(NSDictionary *values) {
+    // Without write times, filled entries are only known to be as fresh as
+    // after.
+    [values enumerateKeysAndObjectsUsingBlock:^(NSString *path, id value, BOOL *stop) {
+      [self fillPath:path value:value timestamp:after generation:generation];
+    }];
+
+    [hits addEntriesFromDictionary:values];
+    return hits;
+  } on:[FNInlineExecutor sharedExecutor]];
+}
+
+- (FNFuture *)setObject:(NSDictionary *)value extraPaths:(NSArray *)paths timestamp:(FNTimestamp)timestamp {
+  NSArray *allPaths = [DerivedPaths(value) arrayByAddingObjectsFromArray:paths];
+  FNTieredCacheEntry *entry = [self insertValue:ImmutableCopy(value) timestamp:timestamp paths:allPaths];
+
+  return [self invalidate:entry unless:[self.backingCache setObject:value extraPaths:paths timestamp:timestamp]];
+}
+
+- (FNFuture *)setObjects:(NSArray *)values timestamp:(FNTimestamp)timestamp {
+  NSMutableArray *entries = [NSMutableArray arrayWithCapacity:values.count];
+
+  for (NSDictionary *value in values) {
+    [entries addObject:[self insertValue:ImmutableCopy(value) timestamp:timestamp paths:DerivedPaths(value)]];
+  }
+
+  return [[self.backingCache setObjects:values timestamp:timestamp] rescue:^(NSError *error) {
+    for (FNTieredCacheEntry *entry in entries) [self remove:entry];
+    return [FNFuture error:error];
+  }];
+}
+
+- (FNFuture *)removeObjectForPath:(NSString *)path timestamp:(FNTimestamp)timestamp {
+  FNTieredCacheEntry *entry = [self insertValue:FNCacheTombstone timestamp:timestamp paths:@[path]];
+
+  return [self invalidate:entry unless:[self.backingCache removeObjectForPath:path timestamp:timestamp]];
+}
+
+#pragma mark Private methods
+
+// Also returns the write generation at the time of the lookup, for filling
+// a miss.
+- (FNTieredCacheEntry *)entryForPath:(NSString *)path after:(FNTimestamp)after generation:(uint64_t *)generation {
+  pthread_mutex_lock(&_lock);
+
+  FNTieredCacheEntry *entry = self.entries[path];
+  *generation = _generation;
+
+  if (entry && entry.timestamp >= after) {
+    [self moveToFront:entry];
+  } else {
+    entry = nil;
+  }
+
+  pthread_mutex_unlock(&_lock);
+
+  return entry;
+}
+
+- (FNFuture *)fillPath:(NSString *)path after:(FNTimestamp)after generation:(uint64_t)generation {
+  return [[self.backingCache cachedObjectForPath:path after:after] map:^id(FNCachedObject *cached) {
+    if (cached) [self fillPath:path value:cached.value timestamp:cached.timestamp generation:generation];
+    return cached;
+  } on:[FNInlineExecutor sharedExecutor]];
+}
+
+// A write that lands while the read is in flight may have superseded the
+// value read, so it is only kept if nothing was written since.
+- (void)fillPath:(NSString *)path value:(id)value timestamp:(FNTimestamp)timestamp generation:(uint64_t)generation {
+  if ([value isKindOfClass:[NSDictionary class]]) {
+    NSMutableArray *paths = [DerivedPaths(value) mutableCopy];
+    if (![paths containsObject:path]) [paths addObject:path];
+
+    [self insertValue:ImmutableCopy(value) timestamp:timestamp paths:paths ifGeneration:generation];
+  } else if (value == FNCacheTombstone) {
+    [self insertValue:FNCacheTombstone timestamp:timestamp paths:@[path] ifGeneration:generation];
+  }
+}
+
+- (FNFuture *)invalidate:(FNTieredCacheEntry *)entry unless:(FNFuture *)write {
+  return [write rescue:^(NSError *error) {
+    [self remove:entry];
+    return [FNFuture error:error];
+  }];
+}
+
+- (FNTieredCacheEntry *)insertValue:(id)value timestamp:(FNTimestamp)timestamp paths:(NSArray *)paths {
+  pthread_mutex_lock(&_lock);
+  FNTieredCacheEntry *entry = [self lockedInsertValue:value timestamp:timestamp paths:paths];
+  _generation++;
+  pthread_mutex_unlock(&_lock);
+
+  return entry;
+}
+
+- (void)insertValue:(id)value timestamp:(FNTimestamp)timestamp paths:(NSArray *)paths ifGeneration:(uint64_t)generation {
+  pthread_mutex_lock(&_lock);
+  if (_generation == generation) [self lockedInsertValue:value timestamp:timestamp paths:paths];
+  pthread_mutex_unlock(&_lock);
+}
+
+// Replaces whatever the paths held. An entry sharing a path with the new
+// one is dropped outright: its other paths would otherwise keep answering
+// with the old value, where the backing cache now has the new one.
+- (FNTieredCacheEntry *)lockedInsertValue:(id)value timestamp:(FNTimestamp)timestamp paths:(NSArray *)paths {
+  for (NSString *path in paths) {
+    FNTieredCacheEntry *old = self.entries[path];
+    if (old) [self unlink:old];
+  }
+
+  FNTieredCacheEntry *entry = [[FNTieredCacheEntry alloc] initWithValue:value timestamp:timestamp paths:paths];
+
+  for (NSString *path in paths) self.entries[path] = entry;
+
+  [self pushFront:entry];
+  _size += entry.size;
+
+  while (_size > self.maxSize && self.tail) [self unlink:self.tail];
+
+  return entry;
+}
+
+- (void)remove:(FNTieredCacheEntry *)entry {
+  pthread_mutex_lock(&_lock);
+  if (self.entries[entry.paths[0]] == entry) [self unlink:entry];
+  pthread_mutex_unlock(&_lock);
+}
+
+- (void)unlink:(FNTieredCacheEntry *)entry {
+  for (NSString *path in entry.paths) {
+    if (self.entries[path] == entry) [self.entries removeObjectForKey:path];
+  }
+
+  FNTieredCacheEntry *next = entry.next;
+
+  if (entry.prev) {
+    entry.prev.next = next;
+  } else {
+    self.head = next;
+  }
+
+  if (next) {
+    next.prev = entry.prev;
+  } else {
+    self.tail = entry.prev;
+  }
+
+  entry.prev = nil;
+  entry.next = nil;
+  _size -= entry.size;
+}
+
+- (void)pushFront:(FNTieredCacheEntry *)entry {
+  entry.next = self.head;
+  entry.prev = nil;
+
+  if (self.head) {
+    self.head.prev = entry;
+  } else {
+    self.tail = entry;
+  }
+
+  self.head = entry;
+}
+
+- (void)moveToFront:(FNTieredCacheEntry *)entry {
+  if (entry == self.head) return;
+
+  FNTieredCacheEntry *next = entry.next;
+
+  entry.prev.next = next;
+  if (next) {
+    next.prev = entry.prev;
+  } else {
+    self.tail = entry.prev;
+  }
+
+  entry.next = self.head;
+  entry.prev = nil;
+  self.head.prev = entry;
+  self.head = entry;
+}
+
+@end
@@ -23,12 +23,17 @@
 - (NSString *)queryStringWithEncoding:(NSStringEncoding)encoding {
   NSMutableArray *pairs = [[NSMutableArray alloc] initWithCapacity:self.count];
 
-  [self enumerateKeysAndObjectsUsingBlock:^(id key, id obj, BOOL *stop) {
+  // Sorted, so equal dictionaries always produce the same string.
+  NSArray *keys = [self.allKeys sortedArrayUsingComparator:^(id a, id b) {
+    return [[a description] compare:[b description]];
+  }];
+
+  for (id key in keys) {
     NSString *k = [[key description] urlEscapedWithEncoding:NSUTF8StringEncoding];
-    NSString *v = [[obj description] urlEscapedWithEncoding:NSUTF8StringEncoding];
+    NSString *v = [[self[key] description] urlEscapedWithEncoding:NSUTF8StringEncoding];
 
     [pairs addObject:[NSString stringWithFormat:@"%@=%@", k, v]];
-  }];
+  }
 
   return [pairs componentsJoinedByString:@"&"];
 }
@@ -17,27 +17,17 @@
 
 #import "NSOperationQueue+FNFutureOperations.h"
 #import "FNMutableFuture.h"
-#import "FNError.h"
 
-@implementation NSOperationQueue (FNFutureOperations)
+@interface FNFuture ()
 
-- (FNFuture *)futureOperationWithBlock:(id (^)(void))block {
-  FNMutableFuture *res = [FNMutableFuture new];
-  NSMutableDictionary *scope = [FNFutureScope saveCurrent];
++ (FNFuture *)futureWithBlock:(id (^)(void))block on:(id<FNExecutor>)executor;
 
-  [self addOperationWithBlock:^{
-    [FNFutureScope inScope:scope perform:^{
-      id rv = res.isCancelled ? FNOperationCancelled() : block();
+@end
 
-      if ([rv isKindOfClass:[NSError class]]) {
-        [res updateError:rv];
-      } else {
-        [res update:rv];
-      }
-    }];
-  }];
+@implementation NSOperationQueue (FNFutureOperations)
 
-  return res;
+- (FNFuture *)futureOperationWithBlock:(id (^)(void))block {
+  return [FNFuture futureWithBlock:block on:[[FNOperationQueueExecutor alloc] initWithOperationQueue:self]];
 }
 
 @end
@@ -21,6 +21,16 @@
 
 - (NSString *)base64Encoded;
 
+/*!
+ Returns the 20 byte SHA-1 digest of the string's UTF-8 bytes.
+ */
+- (NSData *)sha1Digest;
+
+/*!
+ Returns the SHA-1 digest as 40 lowercase hex characters.
+ */
+- (NSString *)sha1HexDigest;
+
 - (NSString *)urlEscapedWithEncoding:(NSStringEncoding)encoding;
 
 @end
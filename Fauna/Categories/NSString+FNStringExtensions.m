@@ -17,6 +17,96 @@
 
 #import "NSString+FNStringExtensions.h"
 
+#if __has_include(<CommonCrypto/CommonDigest.h>)
+#import <CommonCrypto/CommonDigest.h>
+#define FN_HAS_COMMONCRYPTO 1
+#endif
+
+#define FNSHA1DigestLength 20
+
+#ifndef FN_HAS_COMMONCRYPTO
+
+// Plain SHA-1 (FIPS 180-4) for platforms without CommonCrypto.
+static inline uint32_t SHA1Rotate(uint32_t x, int n) {
+  return (x << n) | (x >> (32 - n));
+}
+
+static void SHA1Block(uint32_t h[5], const uint8_t *block) {
+  uint32_t w[80];
+
+  for (int i = 0; i < 16; i++) {
+    w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 | (uint32_t)block[i * 4 + 2] << 8 | block[i * 4 + 3];
+  }
+
+  for (int i = 16; i < 80; i++) {
+    w[i] = SHA1Rotate(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+  }
+
+  uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+
+  for (int i = 0; i < 80; i++) {
+    uint32_t f, k;
+
+    if (i < 20) {
+      f = (b & c) | (~b & d);
+      k = 0x5A827999;
+    } else if (i < 40) {
+      f = b ^ c ^ d;
+      k = 0x6ED9EBA1;
+    } else if (i < 60) {
+      f = (b & c) | (b & d) | (c & d);
+      k = 0x8F1BBCDC;
+    } else {
+      f = b ^ c ^ d;
+      k = 0xCA62C1D6;
+    }
+
+    uint32_t t = SHA1Rotate(a, 5) + f + e + k + w[i];
+    e = d;
+    d = c;
+    c = SHA1Rotate(b, 30);
+    b = a;
+    a = t;
+  }
+
+  h[0] += a;
+  h[1] += b;
+  h[2] += c;
+  h[3] += d;
+  h[4] += e;
+}
+
+static void SHA1(const uint8_t *data, size_t length, uint8_t *digest) {
+  uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+  size_t i = 0;
+
+  for (; i + 64 <= length; i += 64) SHA1Block(h, data + i);
+
+  // The tail, a 1 bit, zero padding, and the bit length fill one or two blocks.
+  uint8_t tail[128] = { 0 };
+  size_t rest = length - i;
+  memcpy(tail, data + i, rest);
+  tail[rest] = 0x80;
+
+  size_t tailLength = rest + 9 <= 64 ? 64 : 128;
+  uint64_t bits = (uint64_t)length * 8;
+
+  for (int j = 0; j < 8; j++) {
+    tail[tailLength - 1 - j] = (uint8_t)(bits >> (j * 8));
+  }
+
+  for (size_t j = 0; j < tailLength; j += 64) SHA1Block(h, tail + j);
+
+  for (int j = 0; j < 5; j++) {
+    digest[j * 4] = (uint8_t)(h[j] >> 24);
+    digest[j * 4 + 1] = (uint8_t)(h[j] >> 16);
+    digest[j * 4 + 2] = (uint8_t)(h[j] >> 8);
+    digest[j * 4 + 3] = (uint8_t)h[j];
+  }
+}
+
+#endif
+
 @implementation NSString (FNStringExtensions)
 
 - (NSString *)base64Encoded {
@@ -58,6 +148,35 @@
   return [[NSString alloc] initWithData:outData encoding:NSASCIIStringEncoding];
 }
 
+- (NSData *)sha1Digest {
+  const char *bytes = [self UTF8String];
+  NSUInteger length = [self lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+  uint8_t digest[FNSHA1DigestLength];
+
+#ifdef FN_HAS_COMMONCRYPTO
+  CC_SHA1(bytes, (CC_LONG)length, digest);
+#else
+  SHA1((const uint8_t *)bytes, length, digest);
+#endif
+
+  return [NSData dataWithBytes:digest length:FNSHA1DigestLength];
+}
+
+- (NSString *)sha1HexDigest {
+  static char const kHexTable[] = "0123456789abcdef";
+
+  NSData *digest = self.sha1Digest;
+  const uint8_t *in = digest.bytes;
+  char out[FNSHA1DigestLength * 2];
+
+  for (NSUInteger i = 0; i < FNSHA1DigestLength; i++) {
+    out[i * 2] = kHexTable[in[i] >> 4];
+    out[i * 2 + 1] = kHexTable[in[i] & 0xF];
+  }
+
+  return [[NSString alloc] initWithBytes:out length:sizeof(out) encoding:NSASCIIStringEncoding];
+}
+
 - (NSString *)urlEscapedWithEncoding:(NSStringEncoding)encoding {
   return CFBridgingRelease(CFURLCreateStringByAddingPercentEscapes(kCFAllocatorDefault, CFBridgingRetain(self), NULL, NULL, CFStringConvertNSStringEncodingToEncoding(encoding)));
 }
@@ -15,6 +15,7 @@
 // specific language governing permissions and limitations under the License.
 //
 
+#import "FNError.h"
 #import "FNMutableFuture.h"
 #import "NSThread+FNFutureOperations.h"
 
@@ -29,13 +30,26 @@
 
 @implementation FNBlockAction
 
+- (void)setFuture:(FNMutableFuture *)future {
+  _future = future;
+
+  // Fail pending actions as soon as they are cancelled, rather than when the
+  // thread gets around to them.
+  FNMutableFuture __weak *wkFuture = future;
+  [future onCancellation:^{
+    [wkFuture updateErrorIfEmpty:FNOperationCancelled()];
+  }];
+}
+
 - (void)run {
+  if (self.future.isCompleted) return;
+
   id rv = self.block();
 
   if ([rv isKindOfClass:[NSError class]]) {
-    [self.future updateError:rv];
+    [self.future updateErrorIfEmpty:rv];
   } else {
-    [self.future update:rv];
+    [self.future updateIfEmpty:rv];
   }
 }
 
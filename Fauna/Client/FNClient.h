@@ -64,8 +64,21 @@ FOUNDATION_EXPORT NSString * const FaunaAPIVersion;
  */
 - (id)initWithPublisherEmail:(NSString *)email password:(NSString *)password;
 
+/*!
+ Returns how many GET requests were served by an identical request already in flight rather than sent. Requests are identical when they have the same credentials, URL, trace ID and timeout.
+ */
++ (NSUInteger)coalescedRequestCount;
+
+/*!
+ Returns a stable, filesystem safe identifier for the client's credentials: the SHA-1 of the auth string as 40 hex characters.
+ */
 - (NSString*) getAuthHash;
 
+/*!
+ Returns the identifier earlier versions derived for these credentials, or nil if they could not derive one. It is cut short at the first NUL in the digest, so unless it is 20 UTF-8 bytes long it may be shared with other credentials. Earlier versions also read past the end of the digest when it had no NUL, so the identifiers they actually used cannot always be rebuilt. Used to find caches written by earlier versions.
+ */
+- (NSString *)legacyAuthHash;
+
 /*!
  Returns a new Client that masquerades as a specific user. Only valid if this Client was initialized with a publisher key.
  @param userRef the ref of the user to masquerade as (e.g. 'users/123')
@@ -21,11 +21,10 @@
 #import "FNRequestOperation.h"
 #import "FNMutableFuture.h"
 #import "FNNetworkStatus.h"
+#import "FNSingleFlight.h"
 #import "NSString+FNStringExtensions.h"
 #import "NSDictionary+FNDictionaryExtensions.h"
 
-#import <CommonCrypto/CommonDigest.h>
-
 #ifndef FAUNA_API_VERSION
 #define FAUNA_API_VERSION @"v1"
 #endif
@@ -70,9 +69,7 @@ NSString * const FaunaAPIBaseURLWithVersion = @"https://" FAUNA_API_HOST @"/" FA
     _authString = authString;
     _authHeaderValue = [@"Basic " stringByAppendingString:authString.base64Encoded];
 
-    unsigned char digest[CC_SHA1_DIGEST_LENGTH];
-    CC_SHA1([authString UTF8String], [authString lengthOfBytesUsingEncoding:NSUTF8StringEncoding], digest);
-    _authHash = [NSString stringWithUTF8String:(const char*)digest];
+    _authHash = authString.sha1HexDigest;
   }
   return self;
 }
@@ -91,11 +88,23 @@ NSString * const FaunaAPIBaseURLWithVersion = @"https://" FAUNA_API_HOST @"/" FA
 
 #pragma mark Public methods
 
++ (NSUInteger)coalescedRequestCount {
+  return self.inFlightRequests.hits;
+}
+
 - (NSString*)getAuthHash {
-  // todo: copy?
   return self.authHash;
 }
 
+- (NSString *)legacyAuthHash {
+  // Earlier versions decoded the raw digest as UTF-8, which stops at the first
+  // NUL and fails on invalid sequences. Without a NUL they read on past the
+  // digest; this rebuilds only the case where the next byte happened to be 0.
+  NSMutableData *digest = [self.authString.sha1Digest mutableCopy];
+  [digest appendBytes:"" length:1];
+  return [NSString stringWithUTF8String:digest.bytes];
+}
+
 - (instancetype)asUser:(NSString *)userRef {
   return [[self.class alloc] initWithKey:self.authString asUser:userRef];
 }
@@ -105,7 +114,15 @@ NSString * const FaunaAPIBaseURLWithVersion = @"https://" FAUNA_API_HOST @"/" FA
 }
 
 - (FNFuture *)get:(NSString *)path parameters:(NSDictionary *)parameters timeout:(NSTimeInterval)timeout {
-  return [self performRequestWithMethod:@"GET" path:path parameters:parameters timeout:timeout];
+  // Identical GETs made while one is in flight share its response. The
+  // query string is built from sorted keys, so equal parameters give equal
+  // keys.
+  NSString *query = [parameters queryStringWithEncoding:NSUTF8StringEncoding] ?: @"";
+  NSString *key = [NSString stringWithFormat:@"%@ GET %@ %@ %@ %f", self.authHash, path, query, self.traceID ?: @"", timeout];
+
+  return [self.class.inFlightRequests futureForKey:key start:^{
+    return [self performRequestWithMethod:@"GET" path:path parameters:parameters timeout:timeout];
+  }];
 }
 
 - (FNFuture *)post:(NSString *)path parameters:(NSDictionary *)parameters timeout:(NSTimeInterval)timeout {
@@ -177,6 +194,16 @@ NSString * const FaunaAPIBaseURLWithVersion = @"https://" FAUNA_API_HOST @"/" FA
   }];
 }
 
++ (FNSingleFlight *)inFlightRequests {
+  static FNSingleFlight *requests = nil;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    requests = [FNSingleFlight new];
+  });
+
+  return requests;
+}
+
 + (NSOperationQueue *)sharedOperationQueue {
   static NSOperationQueue *queue = nil;
   static dispatch_once_t onceToken;
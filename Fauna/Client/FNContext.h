@@ -23,6 +23,13 @@
 @class FNCache;
 @class FNContextConfig;
 
+/*!
+ Posted when a background refresh of a stale cached resource finds that it changed. The object is the FNContext, and the userInfo holds the path under FNContextResourcePathKey and the new resource, or NSNull if it was deleted, under FNContextResourceKey. Posted on the main thread.
+ */
+FOUNDATION_EXPORT NSString * const FNContextResourceDidChangeNotification;
+FOUNDATION_EXPORT NSString * const FNContextResourcePathKey;
+FOUNDATION_EXPORT NSString * const FNContextResourceKey;
+
 /*!
  Fauna API Context
  */
@@ -103,6 +110,16 @@
  */
 + (void)setDefaultCacheSize:(NSUInteger)cacheSize;
 
+/*!
+ Returns the size of the in-memory cache new Context's caches are fronted with.
+ */
++ (NSUInteger)defaultMemoryCacheSize;
+
+/*!
+ Sets the default in-memory cache size. 0 reads everything from disk.
+ */
++ (void)setDefaultMemoryCacheSize:(NSUInteger)cacheSize;
+
 #pragma mark context management
 
 /*!
@@ -143,8 +160,16 @@
 + (FNFuture *)delete:(NSString *)path parameters:(NSDictionary *)parameters;
 
 
+/*!
+ Gets a resource, from the cache if it is within the config's max age. Within its staleWhileRevalidate window past that, the cached resource is returned and refreshed in the background; see FNContextResourceDidChangeNotification.
+ */
 + (FNFuture *)getResource:(NSString *)path;
 
+/*!
+ Gets several resources, reading all cached ones in one cache lookup and fetching the rest. Returns them in the order of paths, with NSNull for any that do not exist.
+ */
++ (FNFuture *)getResources:(NSArray *)paths;
+
 + (FNFuture *)postResource:(NSString *)path parameters:(NSDictionary *)parameters;
 
 + (FNFuture *)putResource:(NSString *)path parameters:(NSDictionary *)parameters;
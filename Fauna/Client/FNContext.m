@@ -23,14 +23,23 @@
 #import "FNNetworkStatus.h"
 #import "FNCache.h"
 #import "FNSQLiteCache.h"
+#import "FNTieredCache.h"
 #import "FNNullCache.h"
+#import "FNCacheRegistry.h"
+#import "FNSingleFlight.h"
 #import "NSString+FNStringExtensions.h"
 #import "NSDictionary+FNFunctionalEnumeration.h"
 
 NSString * const FNFutureScopeContextKey = @"FNContext";
 
+NSString * const FNContextResourceDidChangeNotification = @"FNContextResourceDidChangeNotification";
+NSString * const FNContextResourcePathKey = @"path";
+NSString * const FNContextResourceKey = @"resource";
+
 static NSString * const FNContextSignedInUserTokenKey = @"org.fauna.FNContext.signedInUserToken";
 
+static NSString * const FNContextRemovedNullCacheKey = @"org.fauna.FNContext.removedNullCache";
+
 static FNContext *_defaultContext;
 
 static FNContext *_signedInUserContext;
@@ -49,10 +58,53 @@ static FNContextConfig *DefaultDefaultConfig() {
 
 static NSUInteger _defaultCacheSize = 1 * 1024 * 1024;
 
+static NSUInteger _defaultMemoryCacheSize = 256 * 1024;
+
+// Earlier versions named caches after a lossy decoding of the auth digest.
+// Only a name that decoded exactly the 20 digest bytes belongs to this
+// identity alone, so only that file is moved over. A name cut short at a NUL
+// may be shared with other identities, so that file is dropped. Names that
+// picked up bytes past the digest cannot be rebuilt and are left alone. Runs
+// once per identity per process, before the cache is opened.
+static void MigrateLegacyCache(FNClient *client, NSString *name) {
+  static NSMutableSet *migrated;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    migrated = [NSMutableSet new];
+  });
+
+  @synchronized (migrated) {
+    if ([migrated containsObject:name]) return;
+    [migrated addObject:name];
+
+    NSString *legacy = [client legacyAuthHash];
+
+    if (legacy.length > 0 && ![legacy isEqualToString:name]) {
+      if ([legacy lengthOfBytesUsingEncoding:NSUTF8StringEncoding] == 20) {
+        [FNSQLiteCache moveCacheNamed:legacy toName:name];
+      } else {
+        [FNSQLiteCache removeCacheNamed:legacy];
+      }
+    }
+
+    // The cache used when decoding failed was shared by every such identity,
+    // so it is dropped, once per install rather than for each new identity.
+    NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
+
+    if (![defaults boolForKey:FNContextRemovedNullCacheKey]) {
+      [FNSQLiteCache removeCacheNamed:@"(null)"];
+      [defaults setBool:YES forKey:FNContextRemovedNullCacheKey];
+    }
+  }
+}
+
 @interface FNContext ()
 
 @property (nonatomic, readonly) FNContextConfig *config;
 
+// Set when the cache was acquired from the shared registry.
+@property (nonatomic) NSString *registeredCacheName;
+
 @end
 
 @implementation FNContext
@@ -71,10 +123,36 @@ static NSUInteger _defaultCacheSize = 1 * 1024 * 1024;
 
 - (id)initWithClient:(FNClient *)client {
   FNContextConfig *config = FNContext.defaultConfig ?: DefaultDefaultConfig();
-  FNCache *cache = FNContext.defaultCacheSize > 0 ?
-    [FNSQLiteCache cacheWithName:[client getAuthHash] maxSize:FNContext.defaultCacheSize] :
-    [FNNullCache new];
-  return [self initWithClient:client cache:cache config:config];
+
+  if (FNContext.defaultCacheSize == 0) {
+    return [self initWithClient:client cache:[FNNullCache new] config:config];
+  }
+
+  // Contexts for the same identity share one open cache.
+  NSString *name = [client getAuthHash];
+  NSUInteger cacheSize = FNContext.defaultCacheSize;
+  NSUInteger memoryCacheSize = FNContext.defaultMemoryCacheSize;
+
+  // Kept out of the registry's create block so its file IO does not hold up
+  // other contexts' cache lookups.
+  MigrateLegacyCache(client, name);
+
+  FNCache *cache = [[FNCacheRegistry sharedRegistry] acquireCacheNamed:name create:^{
+    FNCache *disk = [FNSQLiteCache cacheWithName:name maxSize:cacheSize];
+    return memoryCacheSize > 0 ? [[FNTieredCache alloc] initWithBackingCache:disk maxSize:memoryCacheSize] : disk;
+  }];
+
+  self = [self initWithClient:client cache:cache config:config];
+  if (self) {
+    _registeredCacheName = name;
+  } else {
+    [[FNCacheRegistry sharedRegistry] releaseCacheNamed:name];
+  }
+  return self;
+}
+
+- (void)dealloc {
+  if (_registeredCacheName) [[FNCacheRegistry sharedRegistry] releaseCacheNamed:_registeredCacheName];
 }
 
 - (id)initWithKey:(NSString*)keyString {
@@ -164,6 +242,14 @@ static NSUInteger _defaultCacheSize = 1 * 1024 * 1024;
   _defaultCacheSize = cacheSize;
 }
 
++ (NSUInteger)defaultMemoryCacheSize {
+  return _defaultMemoryCacheSize;
+}
+
++ (void)setDefaultMemoryCacheSize:(NSUInteger)cacheSize {
+  _defaultMemoryCacheSize = cacheSize;
+}
+
 + (FNContext *)currentContext {
   return self.scopedContext ?: self.signedInUserContext ?: self.defaultContext;
 }
@@ -224,9 +310,7 @@ static NSUInteger _defaultCacheSize = 1 * 1024 * 1024;
 
 static FNFuture * CacheReferences(FNCache *cache, FNTimestamp time, FNFuture *response) {
   return [response flatMap:^(FNResponse *res) {
-    return [FNFutureJoin([res.references map:^(NSString *ref, NSDictionary *resource) {
-      return [cache setObject:resource extraPaths:@[] timestamp:time];
-    }]) map_:^{
+    return [[cache setObjects:res.references.allValues timestamp:time] map_:^{
       return res;
     }];
   }];
@@ -264,20 +348,48 @@ static FNFuture * CacheUpdatesPageResponse(FNCache *cache, FNTimestamp time, FNF
   NSTimeInterval maxAge = [ctx.config maxAgeForReachabilityStatus:ctx.client.reachabilityStatus];
   FNTimestamp threshold = FNTimestampSubtractInterval(now, maxAge);
 
+  if (ctx.config.staleWhileRevalidate > 0) {
+    FNTimestamp staleThreshold = FNTimestampSubtractInterval(threshold, ctx.config.staleWhileRevalidate);
+
+    return [[ctx.cache cachedObjectForPath:path after:staleThreshold] flatMap:^(FNCachedObject *cached) {
+      if (!cached) return [self fetchResource:path context:ctx time:now];
+
+      id value = cached.value == FNCacheTombstone ? nil : cached.value;
+      if (cached.timestamp <= threshold) [self revalidateResource:path value:value context:ctx];
+
+      return [FNFuture value:value];
+    }];
+  }
+
   return [[ctx.cache objectForPath:path after:threshold] flatMap:^(id value) {
     if (value) {
       return [FNFuture value:(value == FNCacheTombstone ? nil : value)];
     } else {
-      return [CacheResourceResponse(ctx.cache, @[path], now, [self get:path parameters:@{}]) rescue:^(NSError *error){
-        if (ctx.config.fallbackOnError && (error.isFNRequestTimeout || error.isFNInternalServerError)) {
-          return [[ctx.cache objectForPath:path after:FNFirst] flatMap:^(id value){
-            return value ? [FNFuture value:(value == FNCacheTombstone ? nil : value)] : [FNFuture error:error];
-          }];
-        } else {
-          return [FNFuture error:error];
-        }
-      }];
+      return [self fetchResource:path context:ctx time:now];
+    }
+  }];
+}
+
++ (FNFuture *)getResources:(NSArray *)paths {
+  FNContext *ctx = self.currentOrRaise;
+  FNTimestamp now = FNNow();
+  NSTimeInterval maxAge = [ctx.config maxAgeForReachabilityStatus:ctx.client.reachabilityStatus];
+  FNTimestamp threshold = FNTimestampSubtractInterval(now, maxAge);
+
+  return [[ctx.cache objectsForPaths:paths after:threshold] flatMap:^(NSDictionary *values) {
+    NSMutableArray *resources = [NSMutableArray arrayWithCapacity:paths.count];
+
+    for (NSString *path in paths) {
+      id value = values[path];
+
+      if (value) {
+        [resources addObject:[FNFuture value:(value == FNCacheTombstone ? nil : value)]];
+      } else {
+        [resources addObject:[self fetchResource:path context:ctx time:now]];
+      }
     }
+
+    return FNFutureSequence(resources);
   }];
 }
 
@@ -305,7 +417,7 @@ static FNFuture * CacheUpdatesPageResponse(FNCache *cache, FNTimestamp time, FNF
   FNFuture *get = [self get:path parameters:parameters];
   return [CacheEventsPageResponse(ctx.cache, FNNow(), get) map:^(FNResponse *res){
     return res.resource;
-  }];
+  } on:[FNInlineExecutor sharedExecutor]];
 }
 
 + (FNFuture *)getCreatesPage:(NSString *)path parameters:(NSDictionary *)parameters {
@@ -313,7 +425,7 @@ static FNFuture * CacheUpdatesPageResponse(FNCache *cache, FNTimestamp time, FNF
   FNFuture *get = [self get:[path stringByAppendingString:@"/creates"] parameters:parameters];
   return [CacheCreatesPageResponse(ctx.cache, FNNow(), get) map:^(FNResponse *res){
     return res.resource;
-  }];
+  } on:[FNInlineExecutor sharedExecutor]];
 }
 
 + (FNFuture *)getUpdatesPage:(NSString *)path parameters:(NSDictionary *)parameters {
@@ -321,7 +433,7 @@ static FNFuture * CacheUpdatesPageResponse(FNCache *cache, FNTimestamp time, FNF
   FNFuture *get = [self get:[path stringByAppendingString:@"/updates"] parameters:parameters];
   return [CacheUpdatesPageResponse(ctx.cache, FNNow(), get) map:^(FNResponse *res){
     return res.resource;
-  }];
+  } on:[FNInlineExecutor sharedExecutor]];
 }
 
 + (FNFuture *)addToSet:(NSString *)path resource:(NSString *)resource {
@@ -329,7 +441,7 @@ static FNFuture * CacheUpdatesPageResponse(FNCache *cache, FNTimestamp time, FNF
   FNFuture *add = [self post:path parameters:@{@"resource": resource}];
   return [CacheEventsPageResponse(ctx.cache, FNNow(), add) map:^(FNResponse *res){
     return res.resource;
-  }];
+  } on:[FNInlineExecutor sharedExecutor]];
 }
 
 + (FNFuture *)removeFromSet:(NSString *)path resource:(NSString *)resource {
@@ -337,7 +449,7 @@ static FNFuture * CacheUpdatesPageResponse(FNCache *cache, FNTimestamp time, FNF
   FNFuture *remove = [self delete:path parameters:@{@"resource": resource}];
   return [CacheEventsPageResponse(ctx.cache, FNNow(), remove) map:^(FNResponse *res){
     return res.resource;
-  }];
+  } on:[FNInlineExecutor sharedExecutor]];
 }
 
 #pragma mark Private methods
@@ -349,17 +461,54 @@ static FNFuture * CacheUpdatesPageResponse(FNCache *cache, FNTimestamp time, FNF
 }
 
 + (FNContext *)scopedContext {
-  return FNFuture.currentScope[FNFutureScopeContextKey];
+  return [FNFutureScope currentObjectForKey:FNFutureScopeContextKey];
 }
 
 + (void)setScopedContext:(FNContext *)ctx {
-  NSMutableDictionary *scope = FNFuture.currentScope;
+  [FNFutureScope setCurrentObject:ctx forKey:FNFutureScopeContextKey];
+}
 
-  if (ctx) {
-    scope[FNFutureScopeContextKey] = ctx;
-  } else {
-    [scope removeObjectForKey:FNFutureScopeContextKey];
-  }
++ (FNSingleFlight *)revalidations {
+  static FNSingleFlight *revalidations = nil;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    revalidations = [FNSingleFlight new];
+  });
+
+  return revalidations;
+}
+
+// Refreshes a stale cached resource. Concurrent refreshes of one resource
+// share a fetch, so only the first reader's value is compared against.
++ (void)revalidateResource:(NSString *)path value:(id)value context:(FNContext *)ctx {
+  NSString *key = [NSString stringWithFormat:@"%@ %@", [ctx.client getAuthHash], path];
+
+  [self.revalidations futureForKey:key start:^{
+    FNFuture *fetch = [self fetchResource:path context:ctx time:FNNow()];
+
+    // onSuccess: runs on the main queue, which is where observers, mostly
+    // views, want the notification.
+    [fetch onSuccess:^(id resource) {
+      if (resource == value || [resource isEqual:value]) return;
+
+      NSDictionary *info = @{FNContextResourcePathKey: path, FNContextResourceKey: resource ?: [NSNull null]};
+      [[NSNotificationCenter defaultCenter] postNotificationName:FNContextResourceDidChangeNotification object:ctx userInfo:info];
+    }];
+
+    return fetch;
+  }];
+}
+
++ (FNFuture *)fetchResource:(NSString *)path context:(FNContext *)ctx time:(FNTimestamp)now {
+  return [CacheResourceResponse(ctx.cache, @[path], now, [self get:path parameters:@{}]) rescue:^(NSError *error){
+    if (ctx.config.fallbackOnError && (error.isFNRequestTimeout || error.isFNInternalServerError)) {
+      return [[ctx.cache objectForPath:path after:FNFirst] flatMap:^(id value){
+        return value ? [FNFuture value:(value == FNCacheTombstone ? nil : value)] : [FNFuture error:error];
+      }];
+    } else {
+      return [FNFuture error:error];
+    }
+  }];
 }
 
 @end
@@ -26,8 +26,15 @@
 @property (nonatomic, readonly) NSTimeInterval requestTimeout;
 @property (nonatomic, readonly) BOOL fallbackOnError;
 
+/*!
+ Seconds past the max age during which a cached resource is still returned at once, while a refresh runs in the background. 0, the default, disables this.
+ */
+@property (nonatomic, readonly) NSTimeInterval staleWhileRevalidate;
+
 - (id)initWithMaxWifiAge:(NSTimeInterval)wifiAge maxWWANAge:(NSTimeInterval)wwanAge timeout:(NSTimeInterval)timeout fallbackOnError:(BOOL)fallback;
 
+- (id)initWithMaxWifiAge:(NSTimeInterval)wifiAge maxWWANAge:(NSTimeInterval)wwanAge timeout:(NSTimeInterval)timeout fallbackOnError:(BOOL)fallback staleWhileRevalidate:(NSTimeInterval)stale;
+
 + (instancetype)configWithMaxWifiAge:(NSTimeInterval)wifiAge maxWWANAge:(NSTimeInterval)wwanAge timeout:(NSTimeInterval)timeout fallbackOnError:(BOOL)fallback;
 
 - (instancetype)withMaxAge:(NSTimeInterval)age;
@@ -40,6 +47,8 @@
 
 - (instancetype)withFallbackOnError:(BOOL)fallback;
 
+- (instancetype)withStaleWhileRevalidate:(NSTimeInterval)stale;
+
 - (NSTimeInterval)maxAgeForReachabilityStatus:(FNReachabilityStatus)status;
 
 @end
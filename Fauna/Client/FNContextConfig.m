@@ -20,12 +20,17 @@
 @implementation FNContextConfig
 
 - (id)initWithMaxWifiAge:(NSTimeInterval)wifiAge maxWWANAge:(NSTimeInterval)wwanAge timeout:(NSTimeInterval)timeout fallbackOnError:(BOOL)fallback {
+  return [self initWithMaxWifiAge:wifiAge maxWWANAge:wwanAge timeout:timeout fallbackOnError:fallback staleWhileRevalidate:0];
+}
+
+- (id)initWithMaxWifiAge:(NSTimeInterval)wifiAge maxWWANAge:(NSTimeInterval)wwanAge timeout:(NSTimeInterval)timeout fallbackOnError:(BOOL)fallback staleWhileRevalidate:(NSTimeInterval)stale {
   self = [super init];
   if (self) {
     _maxWifiAge = wifiAge;
     _maxWWANAge = wwanAge;
     _requestTimeout = timeout;
     _fallbackOnError = fallback;
+    _staleWhileRevalidate = stale;
   }
 
   return self;
@@ -36,38 +41,51 @@
 }
 
 - (instancetype)withMaxAge:(NSTimeInterval)age {
-  return [FNContextConfig configWithMaxWifiAge:age
-                                    maxWWANAge:age
-                                       timeout:self.requestTimeout
-                               fallbackOnError:self.fallbackOnError];
+  return [[FNContextConfig alloc] initWithMaxWifiAge:age
+                                          maxWWANAge:age
+                                             timeout:self.requestTimeout
+                                     fallbackOnError:self.fallbackOnError
+                                staleWhileRevalidate:self.staleWhileRevalidate];
 }
 
 - (instancetype)withMaxWifiAge:(NSTimeInterval)wifiAge {
-  return [FNContextConfig configWithMaxWifiAge:wifiAge
-                                    maxWWANAge:self.maxWWANAge
-                                       timeout:self.requestTimeout
-                               fallbackOnError:self.fallbackOnError];
+  return [[FNContextConfig alloc] initWithMaxWifiAge:wifiAge
+                                          maxWWANAge:self.maxWWANAge
+                                             timeout:self.requestTimeout
+                                     fallbackOnError:self.fallbackOnError
+                                staleWhileRevalidate:self.staleWhileRevalidate];
 }
 
 - (instancetype)withMaxWWANAge:(NSTimeInterval)wwanAge {
-  return [FNContextConfig configWithMaxWifiAge:self.maxWifiAge
-                                    maxWWANAge:wwanAge
-                                       timeout:self.requestTimeout
-                               fallbackOnError:self.fallbackOnError];
+  return [[FNContextConfig alloc] initWithMaxWifiAge:self.maxWifiAge
+                                          maxWWANAge:wwanAge
+                                             timeout:self.requestTimeout
+                                     fallbackOnError:self.fallbackOnError
+                                staleWhileRevalidate:self.staleWhileRevalidate];
 }
 
 - (instancetype)withTimeout:(NSTimeInterval)timeout {
-  return [FNContextConfig configWithMaxWifiAge:self.maxWifiAge
-                                    maxWWANAge:self.maxWWANAge
-                                       timeout:timeout
-                               fallbackOnError:self.fallbackOnError];
+  return [[FNContextConfig alloc] initWithMaxWifiAge:self.maxWifiAge
+                                          maxWWANAge:self.maxWWANAge
+                                             timeout:timeout
+                                     fallbackOnError:self.fallbackOnError
+                                staleWhileRevalidate:self.staleWhileRevalidate];
 }
 
 - (instancetype)withFallbackOnError:(BOOL)fallback {
-  return [FNContextConfig configWithMaxWifiAge:self.maxWifiAge
-                                    maxWWANAge:self.maxWWANAge
-                                       timeout:self.requestTimeout
-                               fallbackOnError:fallback];
+  return [[FNContextConfig alloc] initWithMaxWifiAge:self.maxWifiAge
+                                          maxWWANAge:self.maxWWANAge
+                                             timeout:self.requestTimeout
+                                     fallbackOnError:fallback
+                                staleWhileRevalidate:self.staleWhileRevalidate];
+}
+
+- (instancetype)withStaleWhileRevalidate:(NSTimeInterval)stale {
+  return [[FNContextConfig alloc] initWithMaxWifiAge:self.maxWifiAge
+                                          maxWWANAge:self.maxWWANAge
+                                             timeout:self.requestTimeout
+                                     fallbackOnError:self.fallbackOnError
+                                staleWhileRevalidate:stale];
 }
 
 - (NSTimeInterval)maxAgeForReachabilityStatus:(FNReachabilityStatus)status {
@@ -21,6 +21,8 @@ FOUNDATION_EXPORT NSString * const FNErrorDomain;
 
 FOUNDATION_EXPORT NSInteger const FNErrorOperationCancelledCode;
 FOUNDATION_EXPORT NSInteger const FNErrorRequestTimeoutCode;
+FOUNDATION_EXPORT NSInteger const FNErrorMultipleErrorsCode;
+FOUNDATION_EXPORT NSInteger const FNErrorDatabaseBusyCode;
 FOUNDATION_EXPORT NSInteger const FNErrorBadRequestCode;
 FOUNDATION_EXPORT NSInteger const FNErrorUnauthorizedCode;
 FOUNDATION_EXPORT NSInteger const FNErrorNotFoundCode;
@@ -30,6 +32,10 @@ NSError * FNOperationCancelled();
 
 NSError * FNRequestTimeout();
 
+NSError * FNMultipleErrors(NSArray *errors);
+
+NSError * FNDatabaseBusy();
+
 NSError * FNBadRequest(NSString *error, NSDictionary *paramErrors);
 
 NSError * FNUnauthorized();
@@ -52,6 +58,10 @@ NSException * FNInvalidResourceClass(NSString *format, ...);
 
 - (BOOL)isFNRequestTimeout;
 
+- (BOOL)isFNMultipleErrors;
+
+- (BOOL)isFNDatabaseBusy;
+
 - (BOOL)isFNBadRequest;
 
 - (BOOL)isFNUnauthorized;
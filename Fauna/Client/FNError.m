@@ -21,6 +21,8 @@ NSString * const FNErrorDomain = @"org.fauna";
 
 NSInteger const FNErrorOperationCancelledCode = 0;
 NSInteger const FNErrorRequestTimeoutCode = 1;
+NSInteger const FNErrorMultipleErrorsCode = 2;
+NSInteger const FNErrorDatabaseBusyCode = 3;
 NSInteger const FNErrorBadRequestCode = 400;
 NSInteger const FNErrorUnauthorizedCode = 401;
 NSInteger const FNErrorNotFoundCode = 404;
@@ -38,6 +40,18 @@ NSError * FNRequestTimeout() {
                          userInfo:@{}];
 }
 
+NSError * FNMultipleErrors(NSArray *errors) {
+  return [NSError errorWithDomain:FNErrorDomain
+                             code:FNErrorMultipleErrorsCode
+                         userInfo:@{ @"errors": errors }];
+}
+
+NSError * FNDatabaseBusy() {
+  return [NSError errorWithDomain:FNErrorDomain
+                             code:FNErrorDatabaseBusyCode
+                         userInfo:@{}];
+}
+
 NSError * FNBadRequest(NSString *error, NSDictionary *paramErrors) {
   return [NSError errorWithDomain:FNErrorDomain
                              code:FNErrorBadRequestCode
@@ -96,6 +110,14 @@ NSException * FNInvalidResourceClass(NSString *format, ...) {
   return self.isFNError && self.code == FNErrorRequestTimeoutCode;
 }
 
+- (BOOL)isFNMultipleErrors {
+  return self.isFNError && self.code == FNErrorMultipleErrorsCode;
+}
+
+- (BOOL)isFNDatabaseBusy {
+  return self.isFNError && self.code == FNErrorDatabaseBusyCode;
+}
+
 - (BOOL)isFNBadRequest {
   return self.isFNError && self.code == FNErrorBadRequestCode;
 }
@@ -65,6 +65,11 @@ static NSThread * FNRequestThread() {
     self.future = future;
 
     FNRequestOperation __weak *wkSelf = self;
+
+    [future onCancellation:^{
+      [wkSelf cancel];
+    }];
+
     self.completionBlock = ^{
       if (wkSelf.isCancelled) wkSelf.error = FNOperationCancelled();
 
@@ -133,7 +138,12 @@ static NSThread * FNRequestThread() {
 }
 
 - (void)cancelOnThread {
-  if (self.connection) [self.connection cancel];
+  // A cancelled connection sends no further delegate messages, so finish here
+  // to complete the future and release the connection slot right away.
+  if (self.connection && !self.isFinished) {
+    [self.connection cancel];
+    [self finish];
+  }
 }
 
 + (void)threadStart {
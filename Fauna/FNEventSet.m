@@ -240,9 +240,9 @@
 }
 
 - (FNFuture *)resources {
-  return FNFutureSequence([self.events map:^(FNEvent *ev){
-    return ev.resource;
-  }]);
+  return [FNResource getAll:[self.events map:^(FNEvent *ev){
+    return ev.ref;
+  }]];
 }
 
 @end
@@ -75,6 +75,12 @@
  */
 + (FNFuture *)get:(NSString *)ref;
 
+/*!
+ Retrieves the Resources for the given refs, in order, reading cached ones in one lookup.
+ @param refs Resource refs.
+ */
++ (FNFuture *)getAll:(NSArray *)refs;
+
 /*!
  Returns a deserialized resource for the given JSON dictionary.
  @param dictionary Dictionary representation of the JSON structure for the Resoure
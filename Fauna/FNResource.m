@@ -131,6 +131,18 @@ static void FNInitClassRegistry() {
   }];
 }
 
++ (FNFuture *)getAll:(NSArray *)refs {
+  return [[FNContext getResources:refs] map:^(NSArray *resources) {
+    NSMutableArray *rv = [NSMutableArray arrayWithCapacity:resources.count];
+
+    for (id resource in resources) {
+      [rv addObject:[self resourceWithDictionary:(resource == [NSNull null] ? nil : resource)]];
+    }
+
+    return rv;
+  }];
+}
+
 + (instancetype)resourceWithDictionary:(NSDictionary *)dictionary {
   Class class = [self classForFaunaClass:dictionary[@"class"]];
   return [[class alloc] initWithDictionary:dictionary];
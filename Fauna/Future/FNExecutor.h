@@ -0,0 +1,90 @@
+//
+// FNExecutor.h
+//
+// Copyright (c) 2013 Fauna, Inc.
+//
+// Licensed under the Mozilla Public License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain a
+// copy of the License at
+//
+// http://mozilla.org/MPL/2.0/
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+/*!
+ An object that runs blocks. Futures use executors to decide where their callbacks and transformations run.
+ */
+@protocol FNExecutor <NSObject>
+
+/*!
+ Schedules the block to run. Implementations may run the block before returning.
+ */
+- (void)execute:(void (^)(void))block;
+
+@end
+
+/*!
+ Runs blocks immediately on the calling thread. Suited to cheap transformations which should not pay for a thread handoff.
+ */
+@interface FNInlineExecutor : NSObject <FNExecutor>
+
++ (instancetype)sharedExecutor;
+
+@end
+
+/*!
+ Runs blocks on an NSOperationQueue.
+ */
+@interface FNOperationQueueExecutor : NSObject <FNExecutor>
+
+@property (nonatomic, readonly) NSOperationQueue *queue;
+
+- (id)initWithOperationQueue:(NSOperationQueue *)queue;
+
+@end
+
+/*!
+ Runs blocks one at a time, in submission order, on a private operation queue.
+ */
+@interface FNSerialExecutor : FNOperationQueueExecutor
+
+@end
+
+/*!
+ Runs blocks concurrently on a private operation queue.
+ */
+@interface FNConcurrentExecutor : FNOperationQueueExecutor
+
+/*!
+ Initializes the executor to run at most the given number of blocks at once.
+ */
+- (id)initWithMaxConcurrency:(NSInteger)maxConcurrency;
+
+@end
+
+/*!
+ Runs blocks on a GCD dispatch queue.
+ */
+@interface FNDispatchExecutor : NSObject <FNExecutor>
+
+@property (nonatomic, readonly) dispatch_queue_t queue;
+
+- (id)initWithQueue:(dispatch_queue_t)queue;
+
+/*!
+ Returns an executor for the main dispatch queue.
+ */
++ (instancetype)mainExecutor;
+
+/*!
+ Returns an executor for the default priority global dispatch queue.
+ */
++ (instancetype)globalExecutor;
+
+@end
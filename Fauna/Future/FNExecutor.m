@@ -0,0 +1,121 @@
+//
+// FNExecutor.m
+//
+// Copyright (c) 2013 Fauna, Inc.
+//
+// Licensed under the Mozilla Public License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain a
+// copy of the License at
+//
+// http://mozilla.org/MPL/2.0/
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+//
+
+#import "FNExecutor.h"
+
+@implementation FNInlineExecutor
+
++ (instancetype)sharedExecutor {
+  static FNInlineExecutor *executor;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    executor = [self new];
+  });
+
+  return executor;
+}
+
+- (void)execute:(void (^)(void))block {
+  block();
+}
+
+@end
+
+@implementation FNOperationQueueExecutor
+
+- (id)initWithOperationQueue:(NSOperationQueue *)queue {
+  self = [super init];
+  if (self) {
+    _queue = queue;
+  }
+  return self;
+}
+
+- (void)execute:(void (^)(void))block {
+  [self.queue addOperationWithBlock:block];
+}
+
+@end
+
+@implementation FNSerialExecutor
+
+- (id)init {
+  NSOperationQueue *queue = [NSOperationQueue new];
+  queue.maxConcurrentOperationCount = 1;
+  return [self initWithOperationQueue:queue];
+}
+
+@end
+
+@implementation FNConcurrentExecutor
+
+- (id)init {
+  return [self initWithMaxConcurrency:NSOperationQueueDefaultMaxConcurrentOperationCount];
+}
+
+- (id)initWithMaxConcurrency:(NSInteger)maxConcurrency {
+  NSOperationQueue *queue = [NSOperationQueue new];
+  queue.maxConcurrentOperationCount = maxConcurrency;
+  return [self initWithOperationQueue:queue];
+}
+
+@end
+
+@implementation FNDispatchExecutor
+
+- (id)initWithQueue:(dispatch_queue_t)queue {
+  self = [super init];
+  if (self) {
+    _queue = queue;
+#if !OS_OBJECT_USE_OBJC
+    dispatch_retain(_queue);
+#endif
+  }
+  return self;
+}
+
+#if !OS_OBJECT_USE_OBJC
+- (void)dealloc {
+  dispatch_release(_queue);
+}
+#endif
+
++ (instancetype)mainExecutor {
+  static FNDispatchExecutor *executor;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    executor = [[self alloc] initWithQueue:dispatch_get_main_queue()];
+  });
+
+  return executor;
+}
+
++ (instancetype)globalExecutor {
+  static FNDispatchExecutor *executor;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    executor = [[self alloc] initWithQueue:dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0)];
+  });
+
+  return executor;
+}
+
+- (void)execute:(void (^)(void))block {
+  dispatch_async(self.queue, block);
+}
+
+@end
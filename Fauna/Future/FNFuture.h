@@ -17,6 +17,7 @@
 
 #import <Foundation/Foundation.h>
 #import "FNFutureScope.h"
+#import "FNExecutor.h"
 
 @class FNFuture;
 
@@ -24,18 +25,41 @@ NSException * FNInvalidFutureValue(NSString *format, ...);
 
 NSException * FNFutureAlreadyCompleted(NSString *method, id value);
 
+/*!
+ Returns a new future that contains the result of folding the values of the passed in array of futures, in order, with the provided block. Fails with the first error to occur, without cancelling the other futures. Cancelling the returned future cancels every input. The block will run on an unspecified thread.
+ */
 FNFuture * FNFutureAccumulate(NSArray *futures, id seed, id (^accumulator)(id accum, id value));
 
 /*!
- Returns a new future that contains an array of the results of the passed in array of futures.
+ Returns a new future that contains an array of the results of the passed in array of futures, in order. Nil results are represented by NSNull. Fails with the first error to occur, without cancelling the other futures. Cancelling the returned future cancels every input.
  */
 FNFuture * FNFutureSequence(NSArray *futures);
 
 /*!
- Returns a new future that will complete when all the provided futures complete.
+ Like FNFutureSequence, but waits for all the futures to complete and fails with an error containing every error that occurred.
+ */
+FNFuture * FNFutureSequenceCollectingErrors(NSArray *futures);
+
+/*!
+ Returns a new future that will complete when all the provided futures complete. Fails with the first error to occur, without cancelling the other futures. Cancelling the returned future cancels every input.
  */
 FNFuture * FNFutureJoin(NSArray *futures);
 
+/*!
+ Like FNFutureJoin, but waits for all the futures to complete and fails with an error containing every error that occurred.
+ */
+FNFuture * FNFutureJoinCollectingErrors(NSArray *futures);
+
+/*!
+ Returns a new future with the result of the first of the passed in futures to succeed, cancelling those still pending. Fails with an error containing every error if all of them fail.
+ */
+FNFuture * FNFutureFirstOf(NSArray *futures);
+
+/*!
+ Returns a new future with the result of the first of the passed in futures to complete, successfully or not, cancelling those still pending.
+ */
+FNFuture * FNFutureRace(NSArray *futures);
+
 @interface FNFuture : NSObject
 
 # pragma mark Class methods
@@ -61,7 +85,7 @@ FNFuture * FNFutureJoin(NSArray *futures);
 + (FNFuture *)onMainThread:(id (^)(void))block;
 
 /*! 
- Returns the future-local storage for the current scope. May be shared across threads.
+ Returns the future-local storage for the current scope. Callbacks see the scope as it was when they were registered.
  */
 + (NSMutableDictionary *)currentScope;
 
@@ -92,11 +116,21 @@ FNFuture * FNFutureJoin(NSArray *futures);
  */
 - (BOOL)isCancelled;
 
+/*!
+ Returns the executor callbacks and transformations of this future run on when none is given explicitly, or nil for the default.
+ */
+- (id<FNExecutor>)executor;
+
 /*!
  Blocks on the completion of the future, returning YES if the operation was successful, or NO otherwise.
  */
 - (BOOL)wait;
 
+/*!
+ Blocks on the completion of the future until the deadline passes, returning YES if the operation completed successfully in time, or NO otherwise. A nil deadline waits indefinitely.
+ */
+- (BOOL)waitUntil:(NSDate *)deadline;
+
 /*!
  Blocks on the completion of the future, returning YES if the operation was successful, or NO otherwise. Sets value or error appropriately.
  */
@@ -112,6 +146,16 @@ FNFuture * FNFutureJoin(NSArray *futures);
  */
 - (void)cancel;
 
+/*!
+ Returns a new future with the same result as this one, or which fails with a request timeout error if this one does not complete within the interval. This future is cancelled on timeout.
+ */
+- (FNFuture *)withTimeout:(NSTimeInterval)timeout;
+
+/*!
+ Like withTimeout:, but fails if this future does not complete by the provided date.
+ */
+- (FNFuture *)withDeadline:(NSDate *)deadline;
+
 # pragma mark Non-Blocking and Functional API
 
 /*!
@@ -134,11 +178,26 @@ FNFuture * FNFutureJoin(NSArray *futures);
  */
 - (void)onCompletion:(void (^)(FNFuture *result))block;
 
+/*!
+ Add a callback to run upon completion of the future. The callback will run on the provided executor.
+ */
+- (void)onCompletion:(void (^)(FNFuture *result))block on:(id<FNExecutor>)executor;
+
+/*!
+ Returns a new future with the same result as this one, whose callbacks and transformations run on the provided executor unless one is given explicitly. Futures derived from it inherit the executor.
+ */
+- (FNFuture *)withExecutor:(id<FNExecutor>)executor;
+
 /*!
  Returns a new future that contains this future's value transformed by the provided block. The block will run on an unspecified thread.
  */
 - (FNFuture *)map:(id (^)(id value))block;
 
+/*!
+ Returns a new future that contains this future's value transformed by the provided block. The block will run on the provided executor.
+ */
+- (FNFuture *)map:(id (^)(id value))block on:(id<FNExecutor>)executor;
+
 /*!
  Returns a new future that contains the value returned by the provided block. The block will run on future completion on an unspecified thread.
  */
@@ -154,6 +213,11 @@ FNFuture * FNFutureJoin(NSArray *futures);
  */
 - (FNFuture *)flatMap:(FNFuture * (^)(id value))block;
 
+/*!
+ Returns a new future that contains the result of the future returned by the provided block if this future is successful, or this future's error. The block will run on the provided executor.
+ */
+- (FNFuture *)flatMap:(FNFuture * (^)(id value))block on:(id<FNExecutor>)executor;
+
 /*!
  Returns a new future that contains the result of the future returned by the provided block if this future is successful, or this future's error. The block will run on an unspecified thread.
  */
@@ -174,4 +238,9 @@ FNFuture * FNFutureJoin(NSArray *futures);
  */
 - (FNFuture *)transform:(FNFuture *(^)(FNFuture *result))block;
 
+/*!
+ Returns a new future with the result of transforming this one. The block will run on the provided executor.
+ */
+- (FNFuture *)transform:(FNFuture *(^)(FNFuture *result))block on:(id<FNExecutor>)executor;
+
 @end
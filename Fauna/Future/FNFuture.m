@@ -19,6 +19,10 @@
 #import "FNMutableFuture.h"
 #import "FNValueFuture.h"
 #import "NSOperationQueue+FNFutureOperations.h"
+#import "FNError.h"
+#import "FNTimerWheel.h"
+#import "FNWorkStealingExecutor.h"
+#import "FNFutureTrace.h"
 
 NSException * FNInvalidFutureValue(NSString *format, ...) {
   va_list args;
@@ -33,42 +37,231 @@ NSException * FNFutureAlreadyCompleted(NSString *method, id value) {
   return [NSException exceptionWithName:@"FNFutureAlreadyCompleted" reason:reason userInfo:@{}];
 }
 
-static FNFuture * FNAccumulateHelper(NSArray *futures, int idx, id seed, id (^accumulator)(id accum, id value)) {
-  if (idx >= futures.count) {
-    return [FNFuture value:seed];
-  } else {
-    return [futures[idx] flatMap:^FNFuture *(id value) {
-      return FNAccumulateHelper(futures, idx + 1, accumulator(seed, value), accumulator);
-    }];
+@interface FNFutureFanIn : NSObject
+
+@property (nonatomic, readonly) NSUInteger count;
+@property (nonatomic, readonly) FNMutableFuture *future;
+
+- (id)initWithCount:(NSUInteger)count collectErrors:(BOOL)collectErrors result:(id (^)(FNFutureFanIn *fanIn))result;
+
+- (void)start:(NSArray *)futures;
+
+- (id)valueAtIndex:(NSUInteger)idx;
+
+@end
+
+@interface FNFuture ()
+
+@property BOOL isCancelled;
+@property (nonatomic) id<FNExecutor> executor;
+
+- (BOOL)propagateToIfEmpty:(FNMutableFuture *)other;
+
++ (FNFuture *)futureWithBlock:(id (^)(void))block on:(id<FNExecutor>)executor;
+
+- (FNFutureTrace *)trace;
+
+@end
+
+@interface FNMutableFuture ()
+
+- (void)continueTraceOf:(FNFuture *)parent;
+
+@end
+
+static FNFuture * FNFanIn(NSArray *futures, BOOL collectErrors, id (^result)(FNFutureFanIn *fanIn)) {
+  FNFutureFanIn *fanIn = [[FNFutureFanIn alloc] initWithCount:futures.count collectErrors:collectErrors result:result];
+  [fanIn start:futures];
+  return fanIn.future;
+}
+
+static id FNSequenceResult(FNFutureFanIn *fanIn) {
+  NSMutableArray *rv = [NSMutableArray arrayWithCapacity:fanIn.count];
+
+  for (NSUInteger i = 0; i < fanIn.count; i++) {
+    [rv addObject:[fanIn valueAtIndex:i] ?: [NSNull null]];
   }
+
+  return rv;
 }
 
 FNFuture * FNFutureAccumulate(NSArray *futures, id seed, id (^accumulator)(id accum, id value)) {
-  return FNAccumulateHelper(futures, 0, seed, accumulator);
+  return FNFanIn(futures, NO, ^id(FNFutureFanIn *fanIn) {
+    id accum = seed;
+
+    for (NSUInteger i = 0; i < fanIn.count; i++) {
+      accum = accumulator(accum, [fanIn valueAtIndex:i]);
+    }
+
+    return accum;
+  });
 }
 
 FNFuture * FNFutureSequence(NSArray *futures) {
-  return FNFutureAccumulate(futures, [NSMutableArray arrayWithCapacity:futures.count], ^id(NSMutableArray *arr, id value) {
-    [arr addObject:value];
-    return arr;
+  return FNFanIn(futures, NO, ^id(FNFutureFanIn *fanIn) {
+    return FNSequenceResult(fanIn);
   });
 }
 
-FNFuture * FNFutureJoin(NSArray *futures) {
-  return FNFutureAccumulate(futures, nil, ^(id accum, id __unused value) {
-    return accum;
+FNFuture * FNFutureSequenceCollectingErrors(NSArray *futures) {
+  return FNFanIn(futures, YES, ^id(FNFutureFanIn *fanIn) {
+    return FNSequenceResult(fanIn);
   });
 }
 
-@interface FNFuture ()
+FNFuture * FNFutureJoin(NSArray *futures) {
+  return FNFanIn(futures, NO, nil);
+}
 
-@property BOOL isCancelled;
+FNFuture * FNFutureJoinCollectingErrors(NSArray *futures) {
+  return FNFanIn(futures, YES, nil);
+}
 
-@end
+// Completed inputs, such as the winner of a race, are left alone.
+static void FNCancelPending(NSArray *futures) {
+  for (FNFuture *future in futures) {
+    if (!future.isCompleted) [future cancel];
+  }
+}
 
-@interface FNMutableFuture ()
+FNFuture * FNFutureFirstOf(NSArray *futures) {
+  if (futures.count == 0) return [FNFuture error:FNMultipleErrors(@[])];
+
+  FNMutableFuture *res = [FNMutableFuture new];
+
+  for (FNFuture *future in futures) {
+    [future onCompletion:^(FNFuture *result) {
+      if (!result.isError && [result propagateToIfEmpty:res]) FNCancelPending(futures);
+    } on:[FNInlineExecutor sharedExecutor]];
+  }
+
+  // Each input's callback above runs before the join sees it, so if the
+  // result is still empty once the join fails, every input failed.
+  [FNFutureJoinCollectingErrors(futures) onCompletion:^(FNFuture *all) {
+    if (all.isError) [res updateErrorIfEmpty:all.error];
+  } on:[FNInlineExecutor sharedExecutor]];
+
+  [res onCancellation:^{ FNCancelPending(futures); }];
+
+  return res;
+}
+
+FNFuture * FNFutureRace(NSArray *futures) {
+  if (futures.count == 0) return [FNFuture error:FNMultipleErrors(@[])];
+
+  FNMutableFuture *res = [FNMutableFuture new];
+
+  for (FNFuture *future in futures) {
+    [future onCompletion:^(FNFuture *result) {
+      if ([result propagateToIfEmpty:res]) FNCancelPending(futures);
+    } on:[FNInlineExecutor sharedExecutor]];
+  }
+
+  [res onCancellation:^{ FNCancelPending(futures); }];
+
+  return res;
+}
+
+@implementation FNFutureFanIn {
+  __strong id *_values;
+  __strong NSError **_errors;
+  int32_t volatile _remaining;
+  id (^_result)(FNFutureFanIn *);
+  NSArray *_futures;
+}
+
+- (id)initWithCount:(NSUInteger)count collectErrors:(BOOL)collectErrors result:(id (^)(FNFutureFanIn *))result {
+  self = [super init];
+  if (self) {
+    _count = count;
+    _remaining = (int32_t)count;
+    _result = [result copy];
+    _future = [FNMutableFuture new];
+
+    // Each slot is written once, by the callback of the future at that index.
+    if (result) _values = (__strong id *)calloc(count, sizeof(id));
+    if (collectErrors) _errors = (__strong NSError **)calloc(count, sizeof(id));
+  }
+  return self;
+}
+
+- (void)dealloc {
+  for (NSUInteger i = 0; i < _count; i++) {
+    if (_values) _values[i] = nil;
+    if (_errors) _errors[i] = nil;
+  }
+
+  free(_values);
+  free(_errors);
+}
+
+- (void)start:(NSArray *)futures {
+  if (self.count == 0) {
+    [self finish];
+    return;
+  }
+
+  _futures = futures;
+
+  // Cancelling the combined future cancels every input. Failing does not:
+  // the inputs may have side effects callers still expect to happen.
+  [self.future onCancellation:^{
+    [self cancelInputs];
+  }];
+
+  NSUInteger idx = 0;
+
+  for (FNFuture *future in futures) {
+    NSUInteger i = idx++;
+
+    [future onCompletion:^(FNFuture *result) {
+      [self future:result completedAtIndex:i];
+    } on:[FNInlineExecutor sharedExecutor]];
+  }
+}
+
+- (void)cancelInputs {
+  for (FNFuture *future in _futures) [future cancel];
+}
+
+- (id)valueAtIndex:(NSUInteger)idx {
+  return _values ? _values[idx] : nil;
+}
+
+- (void)future:(FNFuture *)result completedAtIndex:(NSUInteger)idx {
+  if (result.isError) {
+    if (_errors) {
+      _errors[idx] = result.error;
+    } else {
+      [self.future updateErrorIfEmpty:result.error];
+    }
+  } else if (_values) {
+    _values[idx] = result.value;
+  }
 
-- (void)forwardCancellationsTo:(FNFuture *)other;
+  // The decrement is a full barrier, so whoever takes the count to zero sees
+  // every slot written before it.
+  if (__sync_sub_and_fetch(&_remaining, 1) == 0) [self finish];
+}
+
+- (void)finish {
+  if (self.future.isCompleted) return;
+
+  if (_errors) {
+    NSMutableArray *errors = [NSMutableArray new];
+
+    for (NSUInteger i = 0; i < self.count; i++) {
+      if (_errors[i]) [errors addObject:_errors[i]];
+    }
+
+    if (errors.count > 0) {
+      [self.future updateErrorIfEmpty:FNMultipleErrors(errors)];
+      return;
+    }
+  }
+
+  [self.future updateIfEmpty:_result ? _result(self) : nil];
+}
 
 @end
 
@@ -85,7 +278,7 @@ FNFuture * FNFutureJoin(NSArray *futures) {
 }
 
 + (FNFuture *)inBackground:(id (^)(void))block {
-  return [[FNFuture sharedOperationQueue] futureOperationWithBlock:block];
+  return [self futureWithBlock:block on:[FNWorkStealingExecutor sharedExecutor]];
 }
 
 + (FNFuture *)onMainThread:(id (^)(void))block {
@@ -118,7 +311,11 @@ FNFuture * FNFutureJoin(NSArray *futures) {
   @throw @"not implemented";
 }
 
-- (void)onCompletion:(void (^)(FNFuture *))block {
+- (BOOL)waitUntil:(NSDate *)deadline {
+  @throw @"not implemented";
+}
+
+- (void)onCompletion:(void (^)(FNFuture *))block on:(id<FNExecutor>)executor {
   @throw @"not implemented";
 }
 
@@ -148,18 +345,38 @@ FNFuture * FNFutureJoin(NSArray *futures) {
   self.isCancelled = YES;
 }
 
+- (FNFuture *)withTimeout:(NSTimeInterval)timeout {
+  return [self withDeadline:[NSDate dateWithTimeIntervalSinceNow:timeout]];
+}
+
+- (FNFuture *)withDeadline:(NSDate *)deadline {
+  if (self.isCompleted) return self;
+
+  FNMutableFuture *res = [FNMutableFuture new];
+  res.executor = self.executor;
+  [res continueTraceOf:self];
+
+  FNTimerWheel *wheel = [FNTimerWheel sharedWheel];
+  id timer = [wheel scheduleAt:deadline block:^{
+    if ([res updateErrorIfEmpty:FNRequestTimeout()]) [self cancel];
+  }];
+
+  [self onCompletion:^(FNFuture *self) {
+    [wheel cancelTimer:timer];
+    [self propagateToIfEmpty:res];
+  } on:[FNInlineExecutor sharedExecutor]];
+
+  [res forwardCancellationsTo:self];
+
+  return res;
+}
+
 # pragma mark Non-Blocking and Functional API
 
 -(void)onSuccess:(void (^)(id value))succBlock onError:(void (^)(NSError *))errBlock {
   [self onCompletion:^(FNFuture *self){
-    NSMutableDictionary *scope = [FNFutureScope saveCurrent];
-    
-    [[NSOperationQueue mainQueue] addOperationWithBlock:^{
-      [FNFutureScope inScope:scope perform:^{
-        self.isError ? errBlock(self.error) : succBlock(self.value);
-      }];
-    }];
-  }];
+    self.isError ? errBlock(self.error) : succBlock(self.value);
+  } on:[FNDispatchExecutor mainExecutor]];
 }
 
 - (void)onSuccess:(void (^)(id value))block {
@@ -170,10 +387,32 @@ FNFuture * FNFutureJoin(NSArray *futures) {
   [self onSuccess:^(id _){} onError:block];
 }
 
+- (void)onCompletion:(void (^)(FNFuture *))block {
+  [self onCompletion:block on:self.executor];
+}
+
+- (FNFuture *)withExecutor:(id<FNExecutor>)executor {
+  FNMutableFuture *res = [FNMutableFuture new];
+  res.executor = executor;
+  [res continueTraceOf:self];
+
+  [self onCompletion:^(FNFuture *self) {
+    [self propagateTo:res];
+  } on:[FNInlineExecutor sharedExecutor]];
+
+  [res forwardCancellationsTo:self];
+
+  return res;
+}
+
 - (FNFuture *)map:(id (^)(id value))block {
+  return [self map:block on:self.executor];
+}
+
+- (FNFuture *)map:(id (^)(id value))block on:(id<FNExecutor>)executor {
   return [self flatMap:^(id value){
     return [FNFuture value:block(value)];
-  }];
+  } on:executor];
 }
 
 - (FNFuture *)map_:(id (^)(void))block {
@@ -181,9 +420,13 @@ FNFuture * FNFutureJoin(NSArray *futures) {
 }
 
 - (FNFuture *)flatMap:(FNFuture *(^)(id value))block {
+  return [self flatMap:block on:self.executor];
+}
+
+- (FNFuture *)flatMap:(FNFuture *(^)(id value))block on:(id<FNExecutor>)executor {
   return [self transform:^FNFuture *(FNFuture *self) {
     return self.isError ? self : block(self.value);
-  }];
+  } on:executor];
 }
 
 - (FNFuture *)flatMap_:(FNFuture *(^)(void))block {
@@ -213,7 +456,13 @@ FNFuture * FNFutureJoin(NSArray *futures) {
 }
 
 - (FNFuture *)transform:(FNFuture *(^)(FNFuture *result))block {
+  return [self transform:block on:self.executor];
+}
+
+- (FNFuture *)transform:(FNFuture *(^)(FNFuture *result))block on:(id<FNExecutor>)executor {
   FNMutableFuture *res = [FNMutableFuture new];
+  res.executor = self.executor;
+  [res continueTraceOf:self];
 
   [self onCompletion:^(FNFuture *self) {
     FNFuture *next = block(self);
@@ -225,11 +474,12 @@ FNFuture * FNFutureJoin(NSArray *futures) {
     if (next.isCompleted) {
       [next propagateTo:res];
     } else {
+      [res forwardCancellationsTo:next];
       [next onCompletion:^(FNFuture *next) {
         [next propagateTo:res];
-      }];
+      } on:[FNInlineExecutor sharedExecutor]];
     }
-  }];
+  } on:executor];
 
   [res forwardCancellationsTo:self];
 
@@ -238,6 +488,10 @@ FNFuture * FNFutureJoin(NSArray *futures) {
 
 # pragma mark Private Methods/Helpers
 
+- (FNFutureTrace *)trace {
+  return nil;
+}
+
 - (void)propagateTo:(FNMutableFuture *)other {
   if (self.isError) {
     [other updateError:self.error];
@@ -246,14 +500,41 @@ FNFuture * FNFutureJoin(NSArray *futures) {
   }
 }
 
-+ (NSOperationQueue *)sharedOperationQueue {
-  static NSOperationQueue *queue = nil;
-  static dispatch_once_t onceToken;
-  dispatch_once(&onceToken, ^{
-    queue = [NSOperationQueue new];
-  });
+- (BOOL)propagateToIfEmpty:(FNMutableFuture *)other {
+  if (self.isError) {
+    return [other updateErrorIfEmpty:self.error];
+  } else {
+    return [other updateIfEmpty:self.value];
+  }
+}
+
++ (FNFuture *)futureWithBlock:(id (^)(void))block on:(id<FNExecutor>)executor {
+  FNMutableFuture *res = [FNMutableFuture new];
+  FNFutureScope *scope = [FNFutureScope saveCurrent];
 
-  return queue;
+  FNMutableFuture __weak *wkRes = res;
+
+  // Fail pending blocks as soon as they are cancelled, rather than when they
+  // reach the front of the queue.
+  [res onCancellation:^{
+    [wkRes updateErrorIfEmpty:FNOperationCancelled()];
+  }];
+
+  [executor execute:^{
+    if (res.isCompleted) return;
+
+    [FNFutureScope inScope:scope perform:^{
+      id rv = res.isCancelled ? FNOperationCancelled() : block();
+
+      if ([rv isKindOfClass:[NSError class]]) {
+        [res updateErrorIfEmpty:rv];
+      } else {
+        [res updateIfEmpty:rv];
+      }
+    }];
+  }];
+
+  return res;
 }
 
 @end
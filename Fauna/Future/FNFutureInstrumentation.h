@@ -0,0 +1,75 @@
+//
+// FNFutureInstrumentation.h
+//
+// Copyright (c) 2013 Fauna, Inc.
+//
+// Licensed under the Mozilla Public License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain a
+// copy of the License at
+//
+// http://mozilla.org/MPL/2.0/
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+/*!
+ Timings for one future chain: a future and those derived from it with map:, flatMap:, transform: and friends, up to the last of their callbacks.
+ */
+@interface FNFutureChainMetrics : NSObject
+
+/*!
+ Seconds from the creation of the chain's first future until its last callback returned.
+ */
+@property (nonatomic, readonly) NSTimeInterval duration;
+
+/*!
+ Seconds each callback spent queued on its executor before running, one NSNumber per executor hop, in the order they ran.
+ */
+@property (nonatomic, readonly) NSArray *queueWaits;
+
+/*!
+ The number of callbacks handed to an executor rather than run inline.
+ */
+@property (nonatomic, readonly) NSUInteger hops;
+
+/*!
+ The number of callbacks run.
+ */
+@property (nonatomic, readonly) NSUInteger callbacks;
+
+/*!
+ The number of futures in the chain.
+ */
+@property (nonatomic, readonly) NSUInteger futures;
+
+- (id)initWithDuration:(NSTimeInterval)duration queueWaits:(NSArray *)queueWaits callbacks:(NSUInteger)callbacks futures:(NSUInteger)futures;
+
+@end
+
+@protocol FNFutureInstrumentationDelegate <NSObject>
+
+/*!
+ Called on an unspecified thread once every future in a chain has completed and every callback registered on them has run.
+ */
+- (void)futureChainDidComplete:(FNFutureChainMetrics *)metrics;
+
+@end
+
+/*!
+ Opt-in collection of FNFuture chain timings. Instrumentation is off until a delegate is set; while it is off futures only pay for a nil check.
+ */
+@interface FNFutureInstrumentation : NSObject
+
+/*!
+ Sets the object receiving metrics, enabling instrumentation for futures created from now on. Pass nil to disable it. The delegate is retained.
+ */
++ (void)setDelegate:(id<FNFutureInstrumentationDelegate>)delegate;
+
++ (id<FNFutureInstrumentationDelegate>)delegate;
+
+@end
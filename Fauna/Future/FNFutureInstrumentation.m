@@ -0,0 +1,136 @@
+//
+// FNFutureInstrumentation.m
+//
+// Copyright (c) 2013 Fauna, Inc.
+//
+// Licensed under the Mozilla Public License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain a
+// copy of the License at
+//
+// http://mozilla.org/MPL/2.0/
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+//
+
+#import "FNFutureInstrumentation.h"
+#import "FNFutureTrace.h"
+
+BOOL FNFutureTracingEnabled = NO;
+
+static id<FNFutureInstrumentationDelegate> FNInstrumentationDelegate;
+
+@implementation FNFutureChainMetrics
+
+- (id)initWithDuration:(NSTimeInterval)duration queueWaits:(NSArray *)queueWaits callbacks:(NSUInteger)callbacks futures:(NSUInteger)futures {
+  self = [super init];
+  if (self) {
+    _duration = duration;
+    _queueWaits = queueWaits;
+    _callbacks = callbacks;
+    _futures = futures;
+  }
+  return self;
+}
+
+- (NSUInteger)hops {
+  return self.queueWaits.count;
+}
+
+- (NSString *)description {
+  return [NSString stringWithFormat:@"<FNFutureChainMetrics duration: %.6f hops: %lu callbacks: %lu futures: %lu>",
+          self.duration, (unsigned long)self.hops, (unsigned long)self.callbacks, (unsigned long)self.futures];
+}
+
+@end
+
+@implementation FNFutureInstrumentation
+
++ (void)setDelegate:(id<FNFutureInstrumentationDelegate>)delegate {
+  @synchronized (self) {
+    FNInstrumentationDelegate = delegate;
+    FNFutureTracingEnabled = delegate != nil;
+  }
+}
+
++ (id<FNFutureInstrumentationDelegate>)delegate {
+  @synchronized (self) {
+    return FNInstrumentationDelegate;
+  }
+}
+
+@end
+
+@interface FNFutureTrace () {
+  int32_t volatile _references;
+  int32_t volatile _callbacks;
+  int32_t volatile _futures;
+}
+
+@property (nonatomic, readonly) NSTimeInterval createdAt;
+@property (nonatomic, readonly) NSMutableArray *queueWaits;
+
+@end
+
+@implementation FNFutureTrace
+
++ (FNFutureTrace *)traceIfEnabled {
+  return FNFutureTracingEnabled ? [self new] : nil;
+}
+
+- (id)init {
+  self = [super init];
+  if (self) {
+    _createdAt = FNFutureTraceNow();
+    _queueWaits = [NSMutableArray new];
+    _references = 1;
+    _futures = 1;
+  }
+  return self;
+}
+
+- (BOOL)join {
+  int32_t refs;
+  do {
+    refs = _references;
+    if (refs == 0) return NO;
+  } while (!__sync_bool_compare_and_swap(&_references, refs, refs + 1));
+
+  return YES;
+}
+
+- (void)leave {
+  if (__sync_sub_and_fetch(&_references, 1) > 0) return;
+
+  NSArray *waits;
+  @synchronized (self) {
+    waits = [self.queueWaits copy];
+  }
+
+  FNFutureChainMetrics *metrics = [[FNFutureChainMetrics alloc] initWithDuration:FNFutureTraceNow() - self.createdAt
+                                                                      queueWaits:waits
+                                                                       callbacks:(NSUInteger)_callbacks
+                                                                         futures:(NSUInteger)_futures];
+
+  [[FNFutureInstrumentation delegate] futureChainDidComplete:metrics];
+}
+
+- (void)futureJoined {
+  __sync_add_and_fetch(&_futures, 1);
+}
+
+- (void)callbackDidRun {
+  __sync_add_and_fetch(&_callbacks, 1);
+}
+
+- (void)hopWasQueuedAt:(NSTimeInterval)queuedAt {
+  NSNumber *wait = @(FNFutureTraceNow() - queuedAt);
+
+  @synchronized (self) {
+    [self.queueWaits addObject:wait];
+  }
+}
+
+@end
@@ -17,10 +17,46 @@
 
 #import <Foundation/Foundation.h>
 
+/*!
+ An immutable set of future-local bindings. Scopes are captured by pointer when callbacks are registered, and are updated copy-on-write, so a captured scope never changes.
+ */
 @interface FNFutureScope : NSObject
 
+/*!
+ Returns the value bound to the key in this scope, or nil.
+ */
+- (id)objectForKey:(id)key;
+
+- (id)objectForKeyedSubscript:(id)key;
+
+/*!
+ Returns a new scope with the key bound to the value, sharing the rest of its bindings with this one. A nil value removes the binding.
+ */
+- (FNFutureScope *)scopeBySettingObject:(id)value forKey:(id<NSCopying>)key;
+
+/*!
+ Returns a mutable view of the calling thread's current scope. Mutations replace the thread's current scope, and are not seen by scopes captured earlier.
+ */
 + (NSMutableDictionary *)currentScope;
-+ (NSMutableDictionary *)saveCurrent;
-+ (void)inScope:(NSMutableDictionary *)scope perform:(void (^)(void))block;
+
+/*!
+ Returns the calling thread's current scope, or nil if it has no bindings.
+ */
++ (FNFutureScope *)saveCurrent;
+
+/*!
+ Runs the block with the provided scope as the calling thread's current scope.
+ */
++ (void)inScope:(FNFutureScope *)scope perform:(void (^)(void))block;
+
+/*!
+ Returns the value bound to the key in the calling thread's current scope, or nil.
+ */
++ (id)currentObjectForKey:(id)key;
+
+/*!
+ Binds the key to the value in the calling thread's current scope. A nil value removes the binding.
+ */
++ (void)setCurrentObject:(id)value forKey:(id<NSCopying>)key;
 
 @end
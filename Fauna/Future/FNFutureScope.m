@@ -15,57 +15,189 @@
 // specific language governing permissions and limitations under the License.
 //
 
+#import <pthread.h>
 #import "FNFutureScope.h"
 
-NSString * const FNFutureScopeTLSKey = @"org.fauna.FutureScope";
+// Chains longer than this are flattened on the next update.
+#define FNFutureScopeMaxDepth 8
+
+static pthread_key_t FNFutureScopeTLSKey;
+
+static void ReleaseScope(void *scope) {
+  (void)(__bridge_transfer FNFutureScope *)scope;
+}
+
+static pthread_key_t ScopeTLSKey() {
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    pthread_key_create(&FNFutureScopeTLSKey, ReleaseScope);
+  });
+
+  return FNFutureScopeTLSKey;
+}
+
+static inline FNFutureScope * CurrentScope() {
+  return (__bridge FNFutureScope *)pthread_getspecific(ScopeTLSKey());
+}
+
+static inline void SetCurrentScope(FNFutureScope *scope) {
+  void *prev = pthread_getspecific(ScopeTLSKey());
+  if (prev == (__bridge void *)scope) return;
+
+  pthread_setspecific(ScopeTLSKey(), (__bridge_retained void *)scope);
+  if (prev) ReleaseScope(prev);
+}
+
+@interface FNFutureScope ()
+
+@property (nonatomic, readonly) id key;
+@property (nonatomic, readonly) id value;
+@property (nonatomic, readonly) FNFutureScope *parent;
+@property (nonatomic, readonly) NSUInteger depth;
+@property (nonatomic, readonly) NSUInteger count;
+
+- (id)initWithKey:(id)key value:(id)value parent:(FNFutureScope *)parent count:(NSUInteger)count;
+
+- (NSArray *)allKeys;
+
+@end
+
+@interface FNFutureScopeDictionary : NSMutableDictionary
+
+@end
 
 @implementation FNFutureScope
 
-# pragma mark Class methods
+#pragma mark lifecycle
 
-+ (NSMutableDictionary *)currentScope {
-  NSMutableDictionary *scope = self.tls[FNFutureScopeTLSKey];
-  if (!scope) {
-    scope = [NSMutableDictionary dictionaryWithCapacity:1];
-    self.tls[FNFutureScopeTLSKey] = scope;
+- (id)initWithKey:(id)key value:(id)value parent:(FNFutureScope *)parent count:(NSUInteger)count {
+  self = [super init];
+  if (self) {
+    _key = key;
+    _value = value;
+    _parent = parent;
+    _depth = parent ? parent.depth + 1 : 1;
+    _count = count;
   }
-
-  return scope;
+  return self;
 }
 
-+ (NSMutableDictionary *)saveCurrent {
-  NSMutableDictionary *scope = self.tls[FNFutureScopeTLSKey];
+#pragma mark Public methods
 
-  if (scope && scope.count > 0) {
-    return [NSMutableDictionary dictionaryWithDictionary:scope];
-  } else {
-    return nil;
+- (id)objectForKey:(id)key {
+  for (FNFutureScope *s = self; s; s = s.parent) {
+    if ([s.key isEqual:key]) return s.value;
   }
+
+  return nil;
+}
+
+- (id)objectForKeyedSubscript:(id)key {
+  return [self objectForKey:key];
+}
+
+- (FNFutureScope *)scopeBySettingObject:(id)value forKey:(id<NSCopying>)key {
+  id prev = [self objectForKey:key];
+  if (prev == value) return self;
+
+  NSUInteger count = self.count - (prev ? 1 : 0) + (value ? 1 : 0);
+  if (count == 0) return nil;
+
+  FNFutureScope *parent = self.depth < FNFutureScopeMaxDepth ? self : [self flattened];
+  return [[FNFutureScope alloc] initWithKey:[(id)key copy] value:value parent:parent count:count];
 }
 
-+ (void)inScope:(NSMutableDictionary *)scope perform:(void (^)(void))block {
-  NSMutableDictionary *prev = self.tls[FNFutureScopeTLSKey];
-  self.currentScope = scope;
+#pragma mark Class methods
+
++ (NSMutableDictionary *)currentScope {
+  return [FNFutureScopeDictionary new];
+}
+
++ (FNFutureScope *)saveCurrent {
+  return CurrentScope();
+}
+
++ (void)inScope:(FNFutureScope *)scope perform:(void (^)(void))block {
+  FNFutureScope *prev = CurrentScope();
+  SetCurrentScope(scope);
 
   @try {
     block();
   } @finally {
-    self.currentScope = prev;
+    SetCurrentScope(prev);
+  }
+}
+
++ (id)currentObjectForKey:(id)key {
+  return [CurrentScope() objectForKey:key];
+}
+
++ (void)setCurrentObject:(id)value forKey:(id<NSCopying>)key {
+  FNFutureScope *current = CurrentScope();
+
+  if (current) {
+    SetCurrentScope([current scopeBySettingObject:value forKey:key]);
+  } else if (value) {
+    SetCurrentScope([[FNFutureScope alloc] initWithKey:[(id)key copy] value:value parent:nil count:1]);
+  }
+}
+
+#pragma mark Private methods
+
+- (NSArray *)allKeys {
+  NSMutableArray *keys = [NSMutableArray arrayWithCapacity:self.count];
+  NSMutableSet *seen = [NSMutableSet setWithCapacity:self.depth];
+
+  for (FNFutureScope *s = self; s; s = s.parent) {
+    if ([seen containsObject:s.key]) continue;
+    [seen addObject:s.key];
+    if (s.value) [keys addObject:s.key];
   }
+
+  return keys;
 }
 
-# pragma mark Private methods
+- (FNFutureScope *)flattened {
+  FNFutureScope *rv = nil;
+  NSUInteger count = 0;
 
-+ (void)setCurrentScope:(NSMutableDictionary *)scope {
-  if (scope) {
-    self.tls[FNFutureScopeTLSKey] = scope;
-  } else {
-    [self.tls removeObjectForKey:FNFutureScopeTLSKey];
+  for (id key in self.allKeys) {
+    rv = [[FNFutureScope alloc] initWithKey:key value:[self objectForKey:key] parent:rv count:++count];
   }
+
+  return rv;
+}
+
+@end
+
+@implementation FNFutureScopeDictionary
+
+- (id)init {
+  return [self initWithCapacity:0];
+}
+
+- (id)initWithCapacity:(NSUInteger)numItems {
+  return [super init];
+}
+
+- (NSUInteger)count {
+  return CurrentScope().count;
+}
+
+- (id)objectForKey:(id)aKey {
+  return [FNFutureScope currentObjectForKey:aKey];
+}
+
+- (NSEnumerator *)keyEnumerator {
+  return [CurrentScope().allKeys objectEnumerator];
+}
+
+- (void)setObject:(id)anObject forKey:(id<NSCopying>)aKey {
+  [FNFutureScope setCurrentObject:anObject forKey:aKey];
 }
 
-+ (NSMutableDictionary *)tls {
-  return NSThread.currentThread.threadDictionary;
+- (void)removeObjectForKey:(id)aKey {
+  [FNFutureScope setCurrentObject:nil forKey:aKey];
 }
 
 @end
@@ -0,0 +1,52 @@
+//
+// FNFutureTrace.h
+//
+// Copyright (c) 2013 Fauna, Inc.
+//
+// Licensed under the Mozilla Public License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain a
+// copy of the License at
+//
+// http://mozilla.org/MPL/2.0/
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+FOUNDATION_EXPORT BOOL FNFutureTracingEnabled;
+
+/*!
+ Accumulates FNFutureChainMetrics for a chain of futures. Each future and traced callback in the chain holds a reference; the metrics are reported once the last one leaves.
+ */
+@interface FNFutureTrace : NSObject
+
+/*!
+ Returns a new trace if instrumentation is enabled, or nil. The caller holds the first reference.
+ */
++ (FNFutureTrace *)traceIfEnabled;
+
+/*!
+ Takes another reference, returning NO if the chain has already been reported.
+ */
+- (BOOL)join;
+
+/*!
+ Drops a reference, reporting the chain if it was the last. Futures call this once on completion, callbacks once they return.
+ */
+- (void)leave;
+
+- (void)futureJoined;
+
+- (void)callbackDidRun;
+
+- (void)hopWasQueuedAt:(NSTimeInterval)queuedAt;
+
+@end
+
+static inline NSTimeInterval FNFutureTraceNow(void) {
+  return [NSProcessInfo processInfo].systemUptime;
+}
@@ -40,4 +40,14 @@
  */
 - (BOOL)updateErrorIfEmpty:(NSError *)error;
 
+/*!
+ Registers a block to run when the future is cancelled. The block runs immediately if the future has already been cancelled, and is discarded once the future completes.
+ */
+- (void)onCancellation:(void (^)(void))block;
+
+/*!
+ Forwards cancellation of this future to another, such as the source of its result.
+ */
+- (void)forwardCancellationsTo:(FNFuture *)other;
+
 @end
@@ -15,68 +15,174 @@
 // specific language governing permissions and limitations under the License.
 //
 
+#import <dispatch/dispatch.h>
+#import <errno.h>
+#import <pthread.h>
 #import "FNMutableFuture.h"
+#import "FNWorkStealingExecutor.h"
+#import "FNFutureTrace.h"
+
+#define FNParkingStripes 16
 
 @interface FNFuture ()
 
-+ (NSOperationQueue *)sharedOperationQueue;
+- (FNFutureTrace *)trace;
 
 @end
 
-@interface FNMutableFuture ()
+typedef struct FNCallback {
+  struct FNCallback *next;
+  void *block;
+  void *scope;
+  void *executor;
+  void *trace;
+} FNCallback;
+
+// Swapped in as the callback list head once a future is completed. After that
+// no further callbacks can be pushed and the result ivars are safe to read.
+static FNCallback FNCallbacksCompleted;
+
+// Swapped in as the cancellation handler list head once handlers have run, or
+// once the future completed and they can no longer be useful.
+static FNCallback FNCancellationsFired;
+static FNCallback FNCancellationsDropped;
+
+static void FreeCallbacks(FNCallback *cb) {
+  while (cb) {
+    FNCallback *next = cb->next;
+    (void)(__bridge_transfer id)cb->block;
+    (void)(__bridge_transfer id)cb->scope;
+    (void)(__bridge_transfer id)cb->executor;
+    (void)(__bridge_transfer id)cb->trace;
+    free(cb);
+    cb = next;
+  }
+}
+
+static inline FNCallback * LoadCallbacks(FNCallback * volatile *head) {
+  FNCallback *rv = *head;
+  __sync_synchronize();
+  return rv;
+}
+
+// Blocked waiters park on one of a fixed set of condition variables, picked by
+// the future's address, so waiting does not allocate anything per future.
+static pthread_mutex_t FNParkingMutexes[FNParkingStripes];
+static pthread_cond_t FNParkingConditions[FNParkingStripes];
+
+static NSUInteger ParkingStripe(id future) {
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    for (int i = 0; i < FNParkingStripes; i++) {
+      pthread_mutex_init(&FNParkingMutexes[i], NULL);
+      pthread_cond_init(&FNParkingConditions[i], NULL);
+    }
+  });
+
+  return ((uintptr_t)(__bridge void *)future >> 4) % FNParkingStripes;
+}
 
-@property (nonatomic, readonly) NSMutableArray *dependents;
-@property (nonatomic, readonly) FNFuture *cancellationTarget;
+@interface FNMutableFuture () {
+  int32_t volatile _completing;
+  int32_t volatile _waiters;
+  FNCallback * volatile _callbacks;
+  FNCallback * volatile _cancellations;
+  FNFutureTrace *_trace;
+}
 
 // make read/write
-@property id value;
-@property NSError *error;
-@property BOOL isCompleted;
-@property BOOL isError;
+@property (nonatomic) id value;
+@property (nonatomic) NSError *error;
+@property (nonatomic) BOOL isError;
+
+- (void)scheduleCallbacks:(FNCallback *)pending queuedAt:(NSTimeInterval)queuedAt;
 
 @end
 
+// The callbacks a completion runs inline on a pool worker. Lives on the
+// worker's stack while the batch runs.
+typedef struct {
+  __unsafe_unretained FNMutableFuture *future;
+  FNCallback *pending;
+  NSTimeInterval queuedAt;
+} FNCallbackBatch;
+
+// Called by the pool when a batched callback blocks: queues the callbacks
+// the batch has not reached yet as a new batch.
+static void SpillCallbacks(void *context) {
+  FNCallbackBatch *batch = context;
+  FNCallback *rest = batch->pending;
+  batch->pending = NULL;
+
+  if (rest) [batch->future scheduleCallbacks:rest queuedAt:batch->queuedAt];
+}
+
 @implementation FNMutableFuture
 
 - (id)init {
-  if (self = [super init]) {
-    _dependents = [NSMutableArray new];
+  self = [super init];
+  if (self) {
+    _trace = [FNFutureTrace traceIfEnabled];
   }
-
   return self;
 }
 
+- (void)dealloc {
+  // Only reachable if the future was never completed or cancelled.
+  if (_callbacks != &FNCallbacksCompleted) FreeCallbacks(_callbacks);
+  if (_cancellations != &FNCancellationsFired && _cancellations != &FNCancellationsDropped) FreeCallbacks(_cancellations);
+}
+
 # pragma mark Accessors
 
+- (BOOL)isCompleted {
+  return LoadCallbacks(&_callbacks) == &FNCallbacksCompleted;
+}
+
 - (BOOL)wait {
-  if (!self.isCompleted) {
-    NSOperation *op = [NSOperation new];
-    [self addCompletionOp:op];
-    [op waitUntilFinished];
-  }
+  return [self waitUntil:nil];
+}
+
+- (BOOL)waitUntil:(NSDate *)deadline {
+  if (!self.isCompleted) [self parkUntil:deadline];
 
-  return !self.isError;
+  return self.isCompleted && !self.isError;
 }
 
 - (void)cancel {
   [super cancel];
-  [self.cancellationTarget cancel];
+
+  FNCallback *head;
+  do {
+    head = LoadCallbacks(&_cancellations);
+    if (head == &FNCancellationsFired || head == &FNCancellationsDropped) return;
+  } while (!__sync_bool_compare_and_swap(&_cancellations, head, &FNCancellationsFired));
+
+  FNCallback *handlers = NULL;
+
+  while (head) {
+    FNCallback *next = head->next;
+    head->next = handlers;
+    handlers = head;
+    head = next;
+  }
+
+  while (handlers) {
+    FNCallback *next = handlers->next;
+    void (^block)(void) = (__bridge_transfer id)handlers->block;
+    free(handlers);
+    block();
+    handlers = next;
+  }
 }
 
 # pragma mark Non-Blocking and Functional API
 
-- (void)onCompletion:(void (^)(FNFuture *))block {
-  if (self.isCompleted) {
+- (void)onCompletion:(void (^)(FNFuture *))block on:(id<FNExecutor>)executor {
+  if (!executor && self.isCompleted) {
     block(self);
   } else {
-    NSMutableDictionary *scope = [FNFutureScope saveCurrent];
-    NSOperation *op = [NSBlockOperation blockOperationWithBlock:^{
-      [FNFutureScope inScope:scope perform:^{
-        block(self);
-      }];
-    }];
-
-    [self addCompletionOp:op];
+    [self addCallback:block scope:[FNFutureScope saveCurrent] executor:executor];
   }
 }
 
@@ -105,55 +211,237 @@
   return [self completeIfEmpty:nil error:error];
 }
 
-# pragma mark Private Methods
+- (void)onCancellation:(void (^)(void))block {
+  FNCallback *cb = malloc(sizeof(FNCallback));
+  cb->block = (__bridge_retained void *)[block copy];
+  cb->scope = NULL;
+  cb->executor = NULL;
+  cb->trace = NULL;
+
+  while (YES) {
+    FNCallback *head = LoadCallbacks(&_cancellations);
+
+    if (head == &FNCancellationsFired || head == &FNCancellationsDropped) {
+      cb->next = NULL;
+      FreeCallbacks(cb);
+      if (head == &FNCancellationsFired) block();
+      return;
+    }
+
+    cb->next = head;
+    if (__sync_bool_compare_and_swap(&_cancellations, head, cb)) return;
+  }
+}
 
 - (void)forwardCancellationsTo:(FNFuture *)other {
-  _cancellationTarget = other;
+  [self onCancellation:^{
+    [other cancel];
+  }];
 }
 
-- (void)addCompletionOp:(NSOperation *)op {
-  BOOL added = NO;
+# pragma mark Private Methods
+
+- (FNFutureTrace *)trace {
+  return _trace;
+}
 
-  @synchronized (self) {
-    if (!self.isCompleted) {
-      [self.dependents addObject:op];
-      added = YES;
+- (void)continueTraceOf:(FNFuture *)parent {
+  FNFutureTrace *trace = parent.trace;
+
+  if (_trace && trace && [trace join]) {
+    [trace futureJoined];
+    _trace = trace;
+  }
+}
+
+- (void)parkUntil:(NSDate *)deadline {
+  NSUInteger stripe = ParkingStripe(self);
+  struct timespec ts;
+
+  if (deadline) {
+    NSTimeInterval t = deadline.timeIntervalSince1970;
+    ts.tv_sec = (time_t)t;
+    ts.tv_nsec = (long)((t - ts.tv_sec) * NSEC_PER_SEC);
+  }
+
+  // The completer checks _waiters after publishing its result, and we check
+  // the result after registering here, so one of us always sees the other.
+  __sync_add_and_fetch(&_waiters, 1);
+  [FNWorkStealingExecutor willBlock];
+  pthread_mutex_lock(&FNParkingMutexes[stripe]);
+
+  while (!self.isCompleted) {
+    if (!deadline) {
+      pthread_cond_wait(&FNParkingConditions[stripe], &FNParkingMutexes[stripe]);
+    } else if (pthread_cond_timedwait(&FNParkingConditions[stripe], &FNParkingMutexes[stripe], &ts) == ETIMEDOUT) {
+      break;
     }
   }
 
-  if (!added) [op start];
+  pthread_mutex_unlock(&FNParkingMutexes[stripe]);
+  [FNWorkStealingExecutor didUnblock];
+  __sync_sub_and_fetch(&_waiters, 1);
 }
 
-- (BOOL)completeIfEmpty:(id)value error:(NSError *)error {
-  BOOL updated = NO;
-
-  if (!self.isCompleted) {
-    @synchronized (self) {
-      if (!self.isCompleted) {
-        self.isError = error != nil;
-        self.value = value;
-        self.error = error;
-        self.isCompleted = YES;
-        updated = YES;
+- (void)unparkWaiters {
+  NSUInteger stripe = ParkingStripe(self);
+
+  pthread_mutex_lock(&FNParkingMutexes[stripe]);
+  pthread_cond_broadcast(&FNParkingConditions[stripe]);
+  pthread_mutex_unlock(&FNParkingMutexes[stripe]);
+}
+
+- (void)addCallback:(void (^)(FNFuture *))block scope:(id)scope executor:(id<FNExecutor>)executor {
+  FNCallback *cb = malloc(sizeof(FNCallback));
+  cb->block = (__bridge_retained void *)[block copy];
+  cb->scope = (__bridge_retained void *)scope;
+  cb->executor = (__bridge_retained void *)executor;
+  cb->trace = _trace && [_trace join] ? (__bridge_retained void *)_trace : NULL;
+
+  while (YES) {
+    FNCallback *head = LoadCallbacks(&_callbacks);
+
+    if (head == &FNCallbacksCompleted) {
+      if (executor) {
+        [self executeCallback:cb];
+      } else {
+        [self runCallback:cb];
       }
+      return;
     }
+
+    cb->next = head;
+    if (__sync_bool_compare_and_swap(&_callbacks, head, cb)) return;
   }
+}
+
+- (void)executeCallback:(FNCallback *)cb {
+  id<FNExecutor> executor = (__bridge_transfer id)cb->executor;
+  cb->executor = NULL;
 
-  if (updated) [self operationWasCompleted];
+  if (cb->trace && executor != [FNInlineExecutor sharedExecutor]) {
+    FNFutureTrace *trace = (__bridge FNFutureTrace *)cb->trace;
+    NSTimeInterval queuedAt = FNFutureTraceNow();
 
-  return updated;
+    [executor execute:^{
+      [trace hopWasQueuedAt:queuedAt];
+      [self runCallback:cb];
+    }];
+  } else {
+    [executor execute:^{
+      [self runCallback:cb];
+    }];
+  }
 }
 
-- (void)operationWasCompleted {
-  NSOperationQueue *q = [NSOperationQueue currentQueue];
-  q = q ?: [FNFuture sharedOperationQueue];
+- (void)runCallback:(FNCallback *)cb {
+  void (^block)(FNFuture *) = (__bridge_transfer id)cb->block;
+  id scope = (__bridge_transfer id)cb->scope;
+  (void)(__bridge_transfer id)cb->executor;
+  FNFutureTrace *trace = (__bridge_transfer id)cb->trace;
+  free(cb);
 
-  for (NSOperation *op in self.dependents) {
-    [q addOperation:op];
+  if (scope) {
+    [FNFutureScope inScope:scope perform:^{
+      block(self);
+    }];
+  } else {
+    block(self);
   }
 
-  _dependents = nil;
+  if (trace) {
+    [trace callbackDidRun];
+    [trace leave];
+  }
 }
 
+- (BOOL)completeIfEmpty:(id)value error:(NSError *)error {
+  if (!__sync_bool_compare_and_swap(&_completing, 0, 1)) return NO;
+
+  self.isError = error != nil;
+  self.value = value;
+  self.error = error;
+
+  FNCallback *head;
+  do {
+    head = _callbacks;
+  } while (!__sync_bool_compare_and_swap(&_callbacks, head, &FNCallbacksCompleted));
+
+  if (_waiters > 0) [self unparkWaiters];
+
+  [self dropCancellations];
+
+  [self operationWasCompleted:head];
+
+  [_trace leave];
+
+  return YES;
+}
+
+- (void)dropCancellations {
+  FNCallback *head;
+  do {
+    head = LoadCallbacks(&_cancellations);
+    if (head == &FNCancellationsFired || head == &FNCancellationsDropped) return;
+  } while (!__sync_bool_compare_and_swap(&_cancellations, head, &FNCancellationsDropped));
+
+  FreeCallbacks(head);
+}
+
+- (void)operationWasCompleted:(FNCallback *)head {
+  // Callbacks are pushed LIFO; reverse them into registration order.
+  FNCallback *deferred = NULL;
+
+  while (head) {
+    FNCallback *next = head->next;
+    head->next = deferred;
+    deferred = head;
+    head = next;
+  }
+
+  // Hand those with an explicit executor to it, and batch the rest into a
+  // single pool block.
+  FNCallback *pending = NULL, **tail = &pending;
+
+  while (deferred) {
+    FNCallback *next = deferred->next;
+
+    if (deferred->executor) {
+      [self executeCallback:deferred];
+    } else {
+      deferred->next = NULL;
+      *tail = deferred;
+      tail = &deferred->next;
+    }
+
+    deferred = next;
+  }
+
+  if (pending) [self scheduleCallbacks:pending queuedAt:_trace ? FNFutureTraceNow() : 0];
+}
+
+- (void)scheduleCallbacks:(FNCallback *)pending queuedAt:(NSTimeInterval)queuedAt {
+  [[FNWorkStealingExecutor sharedExecutor] execute:^{
+    [self runCallbacks:pending queuedAt:queuedAt];
+  }];
+}
+
+- (void)runCallbacks:(FNCallback *)pending queuedAt:(NSTimeInterval)queuedAt {
+  // Run in order on this worker. If one blocks, the pool spills the rest back
+  // to itself, so a blocked callback never holds up, or deadlocks on, a
+  // sibling.
+  FNCallbackBatch batch = {self, pending, queuedAt};
+  FNWorkSpill previous = [FNWorkStealingExecutor exchangeSpill:(FNWorkSpill){SpillCallbacks, &batch}];
+
+  while (batch.pending) {
+    FNCallback *cb = batch.pending;
+    batch.pending = cb->next;
+
+    if (cb->trace) [(__bridge FNFutureTrace *)cb->trace hopWasQueuedAt:queuedAt];
+    [self runCallback:cb];
+  }
+
+  [FNWorkStealingExecutor exchangeSpill:previous];
+}
 
 @end
@@ -0,0 +1,37 @@
+//
+// FNSingleFlight.h
+//
+// Copyright (c) 2013 Fauna, Inc.
+//
+// Licensed under the Mozilla Public License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain a
+// copy of the License at
+//
+// http://mozilla.org/MPL/2.0/
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+@class FNFuture;
+
+/*!
+ Coalesces concurrent operations with equal keys. While one is in flight, callers asking for the same key share its result instead of starting another. Each caller gets its own future: cancelling it fails that future with FNOperationCancelled, and the shared operation is cancelled once every caller has cancelled.
+ */
+@interface FNSingleFlight : NSObject
+
+/*!
+ The number of calls that joined an operation already in flight. Safe to read from any thread.
+ */
+@property (nonatomic, readonly) NSUInteger hits;
+
+/*!
+ Returns a future for the operation in flight for key, calling start to begin one if there is none. start runs on the calling thread without holding any lock, so other keys are not held up while it runs. If start throws or returns nil, the exception is raised to this caller, callers that joined meanwhile fail with FNOperationCancelled, and the next caller starts afresh. Keys are copied.
+ */
+- (FNFuture *)futureForKey:(id<NSCopying>)key start:(FNFuture *(^)(void))start;
+
+@end
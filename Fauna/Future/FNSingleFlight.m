@@ -0,0 +1,164 @@
+//
+// FNSingleFlight.m
+//
+// Copyright (c) 2013 Fauna, Inc.
+//
+// Licensed under the Mozilla Public License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain a
+// copy of the License at
+//
+// http://mozilla.org/MPL/2.0/
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+//
+
+#import "FNSingleFlight.h"
+#import "FNFuture.h"
+#import "FNMutableFuture.h"
+#import "FNError.h"
+
+@interface FNSingleFlightCall : NSObject
+
+@property (nonatomic, readonly) FNMutableFuture *future;
+
+// Guarded by @synchronized on the FNSingleFlight.
+@property (nonatomic) FNFuture *upstream;
+@property (nonatomic) NSUInteger waiters;
+@property (nonatomic) BOOL isCancelled;
+
+@end
+
+@implementation FNSingleFlightCall
+
+- (id)init {
+  if (self = [super init]) {
+    _future = [FNMutableFuture new];
+  }
+  return self;
+}
+
+@end
+
+@interface FNSingleFlight () {
+  int64_t volatile _hits;
+}
+
+@property (nonatomic, readonly) NSMutableDictionary *calls;
+
+@end
+
+@implementation FNSingleFlight
+
+- (id)init {
+  if (self = [super init]) {
+    _calls = [NSMutableDictionary new];
+  }
+  return self;
+}
+
+- (NSUInteger)hits {
+  return (NSUInteger)__sync_add_and_fetch(&_hits, 0);
+}
+
+- (FNFuture *)futureForKey:(id<NSCopying>)key start:(FNFuture *(^)(void))start {
+  FNSingleFlightCall *call;
+  BOOL started = NO;
+
+  // Only the placeholder is published under the lock; the operation itself
+  // is started outside it.
+  @synchronized (self) {
+    call = self.calls[key];
+
+    if (call) {
+      __sync_add_and_fetch(&_hits, 1);
+    } else {
+      call = [FNSingleFlightCall new];
+      self.calls[key] = call;
+      started = YES;
+    }
+
+    call.waiters++;
+  }
+
+  if (started) [self startCall:call forKey:key with:start];
+
+  FNMutableFuture *res = [FNMutableFuture new];
+
+  [call.future onCompletion:^(FNFuture *result) {
+    if (result.isError) {
+      [res updateErrorIfEmpty:result.error];
+    } else {
+      [res updateIfEmpty:result.value];
+    }
+  } on:[FNInlineExecutor sharedExecutor]];
+
+  [res onCancellation:^{
+    [res updateErrorIfEmpty:FNOperationCancelled()];
+    [self detachFromCall:call forKey:key];
+  }];
+
+  return res;
+}
+
+#pragma mark Private methods
+
+- (void)startCall:(FNSingleFlightCall *)call forKey:(id)key with:(FNFuture *(^)(void))start {
+  FNFuture *upstream;
+  BOOL cancelled;
+
+  @try {
+    upstream = start();
+    if (!upstream) @throw FNInvalidFutureValue(@"Single-flight operation cannot be nil.");
+  } @catch (NSException *exception) {
+    // The operation never began: later callers must start afresh, and those
+    // already joined fail rather than wait forever.
+    [self removeCall:call forKey:key];
+    [call.future updateErrorIfEmpty:FNOperationCancelled()];
+    @throw;
+  }
+
+  @synchronized (self) {
+    call.upstream = upstream;
+    cancelled = call.isCancelled;
+  }
+
+  [upstream onCompletion:^(FNFuture *result) {
+    // Removed first, so callers reacting to the result start afresh.
+    [self removeCall:call forKey:key];
+
+    if (result.isError) {
+      [call.future updateErrorIfEmpty:result.error];
+    } else {
+      [call.future updateIfEmpty:result.value];
+    }
+  } on:[FNInlineExecutor sharedExecutor]];
+
+  // Every caller cancelled while the operation was being started.
+  if (cancelled) [upstream cancel];
+}
+
+- (void)removeCall:(FNSingleFlightCall *)call forKey:(id)key {
+  @synchronized (self) {
+    if (self.calls[key] == call) [self.calls removeObjectForKey:key];
+  }
+}
+
+- (void)detachFromCall:(FNSingleFlightCall *)call forKey:(id)key {
+  FNFuture *upstream;
+
+  @synchronized (self) {
+    if (--call.waiters > 0) return;
+
+    // Later callers must start afresh rather than join a cancelled operation.
+    call.isCancelled = YES;
+    if (self.calls[key] == call) [self.calls removeObjectForKey:key];
+    upstream = call.upstream;
+  }
+
+  [upstream cancel];
+}
+
+@end
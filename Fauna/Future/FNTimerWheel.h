@@ -0,0 +1,57 @@
+//
+// FNTimerWheel.h
+//
+// Copyright (c) 2013 Fauna, Inc.
+//
+// Licensed under the Mozilla Public License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain a
+// copy of the License at
+//
+// http://mozilla.org/MPL/2.0/
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+/*!
+ A hashed timer wheel. All timers share a single dispatch timer which only runs while timers are pending, so scheduling a timeout costs one small allocation rather than a timer source per future.
+ */
+@interface FNTimerWheel : NSObject
+
+/*!
+ Returns the process-wide timer wheel.
+ */
++ (instancetype)sharedWheel;
+
+/*!
+ Initializes a wheel firing timers with the given resolution.
+ @param resolution the tick length, in seconds
+ @param slots the number of slots in the wheel
+ */
+- (id)initWithResolution:(NSTimeInterval)resolution slots:(NSUInteger)slots;
+
+/*!
+ Schedules the block to run after the interval, rounded up to the wheel's resolution. Returns a timer which may be passed to cancelTimer:. The block runs on a private serial queue.
+ */
+- (id)scheduleAfter:(NSTimeInterval)interval block:(void (^)(void))block;
+
+/*!
+ Schedules the block to run at the provided date. See scheduleAfter:block:.
+ */
+- (id)scheduleAt:(NSDate *)date block:(void (^)(void))block;
+
+/*!
+ Cancels a timer if it has not fired yet, releasing its block.
+ */
+- (void)cancelTimer:(id)timer;
+
+/*!
+ Returns the number of timers which have not yet fired or been cancelled.
+ */
+- (NSUInteger)pendingCount;
+
+@end
@@ -0,0 +1,205 @@
+//
+// FNTimerWheel.m
+//
+// Copyright (c) 2013 Fauna, Inc.
+//
+// Licensed under the Mozilla Public License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain a
+// copy of the License at
+//
+// http://mozilla.org/MPL/2.0/
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+//
+
+#import <pthread.h>
+#import "FNTimerWheel.h"
+
+#define FNTimerWheelDefaultResolution 0.01
+#define FNTimerWheelDefaultSlots 512
+
+@interface FNTimerWheelEntry : NSObject
+
+@property (nonatomic, copy) void (^block)(void);
+@property (nonatomic) uint64_t rounds;
+@property (nonatomic) BOOL isDone;
+
+@end
+
+@implementation FNTimerWheelEntry
+
+@end
+
+@interface FNTimerWheel () {
+  pthread_mutex_t _lock;
+  uint64_t _tick;
+  NSUInteger _pending;
+  BOOL _isRunning;
+}
+
+@property (nonatomic, readonly) NSTimeInterval resolution;
+@property (nonatomic, readonly) NSTimeInterval epoch;
+@property (nonatomic, readonly) NSArray *slots;
+@property (nonatomic, readonly) dispatch_queue_t queue;
+@property (nonatomic, readonly) dispatch_source_t timer;
+
+@end
+
+@implementation FNTimerWheel
+
+#pragma mark lifecycle
+
+- (id)init {
+  return [self initWithResolution:FNTimerWheelDefaultResolution slots:FNTimerWheelDefaultSlots];
+}
+
+- (id)initWithResolution:(NSTimeInterval)resolution slots:(NSUInteger)slots {
+  self = [super init];
+  if (self) {
+    _resolution = resolution;
+    _epoch = [NSProcessInfo processInfo].systemUptime;
+
+    NSMutableArray *wheel = [NSMutableArray arrayWithCapacity:slots];
+    for (NSUInteger i = 0; i < slots; i++) [wheel addObject:[NSMutableArray new]];
+    _slots = wheel;
+
+    pthread_mutex_init(&_lock, NULL);
+
+    _queue = dispatch_queue_create("org.fauna.FNTimerWheel", DISPATCH_QUEUE_SERIAL);
+    _timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, _queue);
+
+    uint64_t interval = (uint64_t)(resolution * NSEC_PER_SEC);
+    dispatch_source_set_timer(_timer, dispatch_time(DISPATCH_TIME_NOW, interval), interval, interval / 2);
+
+    FNTimerWheel __weak *wkSelf = self;
+    dispatch_source_set_event_handler(_timer, ^{
+      [wkSelf advance];
+    });
+  }
+  return self;
+}
+
+- (void)dealloc {
+  if (!_isRunning) dispatch_resume(_timer);
+  dispatch_source_cancel(_timer);
+#if !OS_OBJECT_USE_OBJC
+  dispatch_release(_timer);
+  dispatch_release(_queue);
+#endif
+  pthread_mutex_destroy(&_lock);
+}
+
++ (instancetype)sharedWheel {
+  static FNTimerWheel *wheel;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    wheel = [self new];
+  });
+
+  return wheel;
+}
+
+#pragma mark Public methods
+
+- (id)scheduleAfter:(NSTimeInterval)interval block:(void (^)(void))block {
+  FNTimerWheelEntry *entry = [FNTimerWheelEntry new];
+  entry.block = block;
+
+  pthread_mutex_lock(&_lock);
+
+  // The wheel is empty while the timer is stopped, so skip the idle ticks.
+  if (!_isRunning) _tick = self.currentTick;
+
+  uint64_t ticks = (uint64_t)ceil(MAX(interval, 0) / self.resolution);
+  uint64_t target = self.currentTick + MAX(ticks, 1);
+  if (target <= _tick) target = _tick + 1;
+
+  entry.rounds = (target - _tick - 1) / self.slots.count;
+  [self.slots[target % self.slots.count] addObject:entry];
+  _pending++;
+
+  if (!_isRunning) {
+    _isRunning = YES;
+    dispatch_resume(self.timer);
+  }
+
+  pthread_mutex_unlock(&_lock);
+
+  return entry;
+}
+
+- (id)scheduleAt:(NSDate *)date block:(void (^)(void))block {
+  return [self scheduleAfter:date.timeIntervalSinceNow block:block];
+}
+
+- (void)cancelTimer:(id)timer {
+  FNTimerWheelEntry *entry = timer;
+
+  pthread_mutex_lock(&_lock);
+
+  if (!entry.isDone) {
+    entry.isDone = YES;
+    entry.block = nil;
+    _pending--;
+  }
+
+  pthread_mutex_unlock(&_lock);
+}
+
+- (NSUInteger)pendingCount {
+  pthread_mutex_lock(&_lock);
+  NSUInteger rv = _pending;
+  pthread_mutex_unlock(&_lock);
+  return rv;
+}
+
+#pragma mark Private methods
+
+- (uint64_t)currentTick {
+  return (uint64_t)(([NSProcessInfo processInfo].systemUptime - self.epoch) / self.resolution);
+}
+
+- (void)advance {
+  NSMutableArray *fired = [NSMutableArray new];
+
+  pthread_mutex_lock(&_lock);
+
+  uint64_t now = self.currentTick;
+
+  while (_tick < now) {
+    _tick++;
+
+    NSMutableArray *slot = self.slots[_tick % self.slots.count];
+    NSMutableIndexSet *expired = [NSMutableIndexSet new];
+
+    [slot enumerateObjectsUsingBlock:^(FNTimerWheelEntry *entry, NSUInteger idx, BOOL *stop) {
+      if (entry.isDone) {
+        [expired addIndex:idx];
+      } else if (entry.rounds == 0) {
+        [fired addObject:entry.block];
+        entry.isDone = YES;
+        entry.block = nil;
+        [expired addIndex:idx];
+        _pending--;
+      } else {
+        entry.rounds--;
+      }
+    }];
+
+    [slot removeObjectsAtIndexes:expired];
+  }
+
+  if (_pending == 0 && _isRunning) {
+    _isRunning = NO;
+    dispatch_suspend(self.timer);
+  }
+
+  pthread_mutex_unlock(&_lock);
+
+  for (void (^block)(void) in fired) block();
+}
+
+@end
@@ -48,8 +48,22 @@
   return !self.isError;
 }
 
-- (void)onCompletion:(void (^)(FNFuture *))block {
-  block(self);
+- (BOOL)waitUntil:(NSDate *)deadline {
+  return !self.isError;
+}
+
+- (void)onCompletion:(void (^)(FNFuture *))block on:(id<FNExecutor>)executor {
+  if (executor) {
+    FNFutureScope *scope = [FNFutureScope saveCurrent];
+
+    [executor execute:^{
+      [FNFutureScope inScope:scope perform:^{
+        block(self);
+      }];
+    }];
+  } else {
+    block(self);
+  }
 }
 
 @end
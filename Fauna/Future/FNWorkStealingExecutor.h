@@ -0,0 +1,92 @@
+//
+// FNWorkStealingExecutor.h
+//
+// Copyright (c) 2013 Fauna, Inc.
+//
+// Licensed under the Mozilla Public License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain a
+// copy of the License at
+//
+// http://mozilla.org/MPL/2.0/
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+//
+
+#import "FNExecutor.h"
+
+/*!
+ A function and its argument, registered with +[FNWorkStealingExecutor exchangeSpill:].
+ */
+typedef struct {
+  void (*function)(void *context);
+  void *context;
+} FNWorkSpill;
+
+/*!
+ Runs blocks on a bounded pool of worker threads. Each worker owns a deque: blocks submitted from a worker go on its own deque and are run newest first, while idle workers steal the oldest blocks from the others. Blocks submitted from other threads are spread across the deques.
+
+ A worker that blocks (for instance in -[FNFuture wait]) should bracket the wait with willBlock and didUnblock, so the pool can start a compensating thread to keep the configured number of workers running.
+ */
+@interface FNWorkStealingExecutor : NSObject <FNExecutor>
+
+/*!
+ The number of workers the pool keeps running.
+ */
+@property (nonatomic, readonly) NSUInteger size;
+
+/*!
+ The maximum number of threads, including compensating threads, the pool will start.
+ */
+@property (nonatomic, readonly) NSUInteger maxThreads;
+
+/*!
+ Returns the executor used by inBackground: and by default for future callbacks. It has one worker per active processor.
+ */
++ (instancetype)sharedExecutor;
+
+/*!
+ Initializes a pool with the given number of workers, allowing up to 64 compensating threads.
+ */
+- (id)initWithSize:(NSUInteger)size;
+
+- (id)initWithSize:(NSUInteger)size maxThreads:(NSUInteger)maxThreads;
+
+/*!
+ Returns the number of blocks waiting to run.
+ */
+- (NSUInteger)queueDepth;
+
+/*!
+ Returns the number of blocks run by a worker other than the one they were queued on.
+ */
+- (NSUInteger)stealCount;
+
+/*!
+ Returns the number of threads currently running, including compensating threads.
+ */
+- (NSUInteger)threadCount;
+
+/*!
+ Stops the pool's threads once the blocks already queued have run.
+ */
+- (void)shutdown;
+
+/*!
+ Notes that the current thread is about to block. Does nothing unless it is a worker.
+ */
++ (void)willBlock;
+
+/*!
+ Notes that the current thread has stopped blocking. Must balance a call to willBlock.
+ */
++ (void)didUnblock;
+
+/*!
+ Registers a spill for the current worker and returns the one it replaces, which the caller restores when done. A block that runs a batch of work inline uses it to hand the rest of the batch back to the pool: the next willBlock on this worker clears the spill and calls it before blocking, so the remaining items are not held up behind the blocked one. Does nothing, and returns an empty spill, off a worker.
+ */
++ (FNWorkSpill)exchangeSpill:(FNWorkSpill)spill;
+
+@end
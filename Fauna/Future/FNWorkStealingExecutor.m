@@ -0,0 +1,332 @@
+//
+// FNWorkStealingExecutor.m
+//
+// Copyright (c) 2013 Fauna, Inc.
+//
+// Licensed under the Mozilla Public License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain a
+// copy of the License at
+//
+// http://mozilla.org/MPL/2.0/
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+//
+
+#import <pthread.h>
+#import "FNWorkStealingExecutor.h"
+
+#define FNWorkStealingDefaultCompensation 64
+
+static pthread_key_t FNCurrentWorkerKey;
+
+@interface FNWorkDeque : NSObject
+
+- (void)push:(void (^)(void))block;
+
+- (void (^)(void))popLast;
+
+- (void (^)(void))popFirst;
+
+@end
+
+@interface FNWorker : NSObject {
+  @public
+  int32_t volatile _blocked;
+  FNWorkSpill _spill;
+}
+
+@property (nonatomic, readonly) FNWorkStealingExecutor *pool;
+@property (nonatomic, readonly) NSUInteger index;
+@property (nonatomic, readonly) FNWorker *covering;
+
+- (id)initWithPool:(FNWorkStealingExecutor *)pool index:(NSUInteger)index covering:(FNWorker *)covering;
+
+@end
+
+@interface FNWorkStealingExecutor () {
+  pthread_mutex_t _idleLock;
+  pthread_cond_t _idleCondition;
+  NSUInteger _idle;
+  BOOL _isShutdown;
+  int64_t volatile _pending;
+  int64_t volatile _steals;
+  int32_t volatile _threads;
+  uint32_t volatile _next;
+}
+
+@property (nonatomic, readonly) NSArray *deques;
+
+- (void)compensateFor:(FNWorker *)worker;
+
+- (void)wakeAll;
+
+@end
+
+@implementation FNWorkDeque {
+  pthread_mutex_t _lock;
+  NSMutableArray *_blocks;
+}
+
+- (id)init {
+  self = [super init];
+  if (self) {
+    pthread_mutex_init(&_lock, NULL);
+    _blocks = [NSMutableArray new];
+  }
+  return self;
+}
+
+- (void)dealloc {
+  pthread_mutex_destroy(&_lock);
+}
+
+- (void)push:(void (^)(void))block {
+  pthread_mutex_lock(&_lock);
+  [_blocks addObject:block];
+  pthread_mutex_unlock(&_lock);
+}
+
+- (void (^)(void))popLast {
+  pthread_mutex_lock(&_lock);
+  void (^block)(void) = _blocks.lastObject;
+  if (block) [_blocks removeLastObject];
+  pthread_mutex_unlock(&_lock);
+  return block;
+}
+
+- (void (^)(void))popFirst {
+  pthread_mutex_lock(&_lock);
+  void (^block)(void) = _blocks.count > 0 ? _blocks[0] : nil;
+  if (block) [_blocks removeObjectAtIndex:0];
+  pthread_mutex_unlock(&_lock);
+  return block;
+}
+
+@end
+
+@implementation FNWorker
+
+- (id)initWithPool:(FNWorkStealingExecutor *)pool index:(NSUInteger)index covering:(FNWorker *)covering {
+  self = [super init];
+  if (self) {
+    _pool = pool;
+    _index = index;
+    _covering = covering;
+  }
+  return self;
+}
+
++ (FNWorker *)currentWorker {
+  return (__bridge FNWorker *)pthread_getspecific(FNCurrentWorkerKey);
+}
+
+@end
+
+@implementation FNWorkStealingExecutor
+
+#pragma mark lifecycle
+
++ (void)initialize {
+  if (self == [FNWorkStealingExecutor class]) {
+    pthread_key_create(&FNCurrentWorkerKey, NULL);
+  }
+}
+
+- (id)init {
+  return [self initWithSize:[NSProcessInfo processInfo].activeProcessorCount];
+}
+
+- (id)initWithSize:(NSUInteger)size {
+  return [self initWithSize:size maxThreads:size + FNWorkStealingDefaultCompensation];
+}
+
+- (id)initWithSize:(NSUInteger)size maxThreads:(NSUInteger)maxThreads {
+  self = [super init];
+  if (self) {
+    _size = MAX(size, 1);
+    _maxThreads = MAX(maxThreads, _size);
+
+    pthread_mutex_init(&_idleLock, NULL);
+    pthread_cond_init(&_idleCondition, NULL);
+
+    NSMutableArray *deques = [NSMutableArray arrayWithCapacity:_size];
+    for (NSUInteger i = 0; i < _size; i++) [deques addObject:[FNWorkDeque new]];
+    _deques = deques;
+
+    for (NSUInteger i = 0; i < _size; i++) {
+      [self startWorker:[[FNWorker alloc] initWithPool:self index:i covering:nil]];
+    }
+  }
+  return self;
+}
+
+- (void)dealloc {
+  pthread_cond_destroy(&_idleCondition);
+  pthread_mutex_destroy(&_idleLock);
+}
+
++ (instancetype)sharedExecutor {
+  static FNWorkStealingExecutor *executor;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    executor = [self new];
+  });
+
+  return executor;
+}
+
+#pragma mark Public methods
+
+- (void)execute:(void (^)(void))block {
+  FNWorker *worker = [FNWorker currentWorker];
+  NSUInteger idx = worker.pool == self ? worker.index : __sync_fetch_and_add(&_next, 1) % self.size;
+
+  // Count the block before queueing it, so a worker never sees fewer pending
+  // blocks than it can find.
+  __sync_add_and_fetch(&_pending, 1);
+  [self.deques[idx] push:[block copy]];
+
+  pthread_mutex_lock(&_idleLock);
+  if (_idle > 0) pthread_cond_signal(&_idleCondition);
+  pthread_mutex_unlock(&_idleLock);
+}
+
+- (NSUInteger)queueDepth {
+  return (NSUInteger)MAX(_pending, 0);
+}
+
+- (NSUInteger)stealCount {
+  return (NSUInteger)_steals;
+}
+
+- (NSUInteger)threadCount {
+  return (NSUInteger)_threads;
+}
+
+- (void)shutdown {
+  pthread_mutex_lock(&_idleLock);
+  _isShutdown = YES;
+  pthread_cond_broadcast(&_idleCondition);
+  pthread_mutex_unlock(&_idleLock);
+}
+
++ (void)willBlock {
+  FNWorker *worker = [FNWorker currentWorker];
+
+  if (worker && __sync_add_and_fetch(&worker->_blocked, 1) == 1) {
+    // Queue the rest of any inline batch first, so the compensating thread
+    // can pick it up.
+    FNWorkSpill spill = worker->_spill;
+    worker->_spill = (FNWorkSpill){NULL, NULL};
+    if (spill.function) spill.function(spill.context);
+
+    [worker.pool compensateFor:worker];
+  }
+}
+
++ (void)didUnblock {
+  FNWorker *worker = [FNWorker currentWorker];
+
+  if (worker && __sync_sub_and_fetch(&worker->_blocked, 1) == 0) {
+    [worker.pool wakeAll];
+  }
+}
+
++ (FNWorkSpill)exchangeSpill:(FNWorkSpill)spill {
+  FNWorker *worker = [FNWorker currentWorker];
+  if (!worker) return (FNWorkSpill){NULL, NULL};
+
+  FNWorkSpill previous = worker->_spill;
+  worker->_spill = spill;
+  return previous;
+}
+
+#pragma mark Private methods
+
+- (void)startWorker:(FNWorker *)worker {
+  __sync_add_and_fetch(&_threads, 1);
+  [NSThread detachNewThreadSelector:@selector(runWorker:) toTarget:self withObject:worker];
+}
+
+- (void)compensateFor:(FNWorker *)worker {
+  int32_t threads;
+  do {
+    threads = _threads;
+    if ((NSUInteger)threads >= self.maxThreads) return;
+  } while (!__sync_bool_compare_and_swap(&_threads, threads, threads + 1));
+
+  // The compensating thread shares the blocked worker's deque, and retires
+  // once that worker is running again.
+  FNWorker *compensator = [[FNWorker alloc] initWithPool:self index:worker.index covering:worker];
+  [NSThread detachNewThreadSelector:@selector(runWorker:) toTarget:self withObject:compensator];
+}
+
+- (void)wakeAll {
+  pthread_mutex_lock(&_idleLock);
+  pthread_cond_broadcast(&_idleCondition);
+  pthread_mutex_unlock(&_idleLock);
+}
+
+- (BOOL)shouldRetire:(FNWorker *)worker {
+  return worker.covering && worker.covering->_blocked == 0;
+}
+
+- (void (^)(void))takeBlockFor:(FNWorker *)worker {
+  void (^block)(void) = [self.deques[worker.index] popLast];
+
+  for (NSUInteger i = 1; !block && i < self.size; i++) {
+    block = [self.deques[(worker.index + i) % self.size] popFirst];
+    if (block) __sync_add_and_fetch(&_steals, 1);
+  }
+
+  if (block) __sync_sub_and_fetch(&_pending, 1);
+
+  return block;
+}
+
+- (BOOL)waitForWork:(FNWorker *)worker {
+  BOOL rv = YES;
+
+  pthread_mutex_lock(&_idleLock);
+
+  while (_pending <= 0) {
+    if (_isShutdown || [self shouldRetire:worker]) {
+      rv = NO;
+      break;
+    }
+
+    _idle++;
+    pthread_cond_wait(&_idleCondition, &_idleLock);
+    _idle--;
+  }
+
+  pthread_mutex_unlock(&_idleLock);
+
+  return rv;
+}
+
+- (void)runWorker:(FNWorker *)worker {
+  pthread_setspecific(FNCurrentWorkerKey, (__bridge void *)worker);
+
+  for (;;) {
+    @autoreleasepool {
+      if ([self shouldRetire:worker]) break;
+
+      void (^block)(void) = [self takeBlockFor:worker];
+
+      if (block) {
+        block();
+      } else if (![self waitForWork:worker]) {
+        break;
+      }
+    }
+  }
+
+  pthread_setspecific(FNCurrentWorkerKey, NULL);
+  __sync_sub_and_fetch(&_threads, 1);
+}
+
+@end
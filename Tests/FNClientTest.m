@@ -37,4 +37,13 @@
   [self waitForStatus:kGHUnitWaitStatusSuccess timeout:2.0];
 }
 
+- (void)testAuthHashIsHexSHA1 {
+  FNClient *client = [[FNClient alloc] initWithKey:@"abc"];
+  GHAssertEqualStrings([client getAuthHash], @"a9993e364706816aba3e25717850c26c9cd0d89d", @"auth hash is the hex SHA-1 of the key");
+
+  FNClient *user = [[FNClient alloc] initWithKey:@"abc" asUser:@"users/1"];
+  GHAssertNotEqualStrings([user getAuthHash], [client getAuthHash], @"identities hash apart");
+  GHAssertEquals([user getAuthHash].length, (NSUInteger)40, @"auth hash is full length");
+}
+
 @end
@@ -15,6 +15,11 @@
 // specific language governing permissions and limitations under the License.
 //
 
+#import <Fauna/FNCacheRegistry.h>
+#import <Fauna/FNContextConfig.h>
+#import <Fauna/FNTieredCache.h>
+#import <Fauna/FNNullCache.h>
+
 @interface FNContextTest : GHAsyncTestCase { }
 @end
 
@@ -22,6 +27,8 @@
 
 + (FNContext *)currentOrRaise;
 
+- (id)initWithClient:(FNClient *)client cache:(FNCache *)cache config:(FNContextConfig *)config;
+
 @end
 
 @implementation FNContextTest
@@ -116,4 +123,49 @@
   }
 }
 
+- (void)testSharesCacheAcrossContexts {
+  NSString *key = TestUniqueID();
+  FNCacheRegistry *registry = [FNCacheRegistry sharedRegistry];
+  NSUInteger open;
+
+  @autoreleasepool {
+    FNContext *ctx1 = [FNContext contextWithKey:key];
+    FNContext *ctx2 = [FNContext contextWithKey:key];
+
+    GHAssertEquals(ctx1.cache, ctx2.cache, @"contexts for one identity share a cache");
+    open = registry.count;
+  }
+
+  GHAssertEquals(registry.count, open, @"released cache stays open while idle");
+}
+
+- (void)testConfigKeepsStaleWhileRevalidate {
+  FNContextConfig *config = [[FNContextConfig configWithMaxWifiAge:15 maxWWANAge:15 timeout:240 fallbackOnError:NO] withStaleWhileRevalidate:60];
+
+  GHAssertEquals([config withMaxAge:5].staleWhileRevalidate, (NSTimeInterval)60, @"withMaxAge: dropped the window");
+  GHAssertEquals([config withTimeout:5].staleWhileRevalidate, (NSTimeInterval)60, @"withTimeout: dropped the window");
+  GHAssertEquals([config withFallbackOnError:YES].staleWhileRevalidate, (NSTimeInterval)60, @"withFallbackOnError: dropped the window");
+}
+
+- (void)testRevalidationNotifiesOnMainThread {
+  [self prepare];
+
+  FNCache *cache = [[FNTieredCache alloc] initWithBackingCache:[FNNullCache new] maxSize:64 * 1024];
+  FNContextConfig *config = [[FNContextConfig configWithMaxWifiAge:15 maxWWANAge:15 timeout:240 fallbackOnError:NO] withStaleWhileRevalidate:600];
+  FNContext *ctx = [[FNContext alloc] initWithClient:TestPublisherContext().client cache:cache config:config];
+
+  [cache setObject:@{@"ref": @"publisher", @"stale": @YES} extraPaths:@[] timestamp:FNTimestampSubtractInterval(FNNow(), 60)];
+
+  id observer = [[NSNotificationCenter defaultCenter] addObserverForName:FNContextResourceDidChangeNotification object:ctx queue:nil usingBlock:^(NSNotification *note) {
+    [self notify:([NSThread isMainThread] ? kGHUnitWaitStatusSuccess : kGHUnitWaitStatusFailure) forSelector:@selector(testRevalidationNotifiesOnMainThread)];
+  }];
+
+  NSDictionary *value = [ctx inContext:^{ return [[FNContext getResource:@"publisher"] get]; }];
+  GHAssertEqualObjects(value[@"stale"], @YES, @"stale hit was not returned at once");
+
+  [self waitForStatus:kGHUnitWaitStatusSuccess timeout:5.0];
+
+  [[NSNotificationCenter defaultCenter] removeObserver:observer];
+}
+
 @end
@@ -15,10 +15,16 @@
 // specific language governing permissions and limitations under the License.
 //
 
+#import <libkern/OSAtomic.h>
 #import <Fauna/FNMutableFuture.h>
 #import <Fauna/FNError.h>
+#import <Fauna/FNWorkStealingExecutor.h>
+#import <Fauna/FNFutureInstrumentation.h>
+#import <Fauna/FNSingleFlight.h>
 
-@interface FNFutureTest : GHAsyncTestCase { }
+@interface FNFutureTest : GHAsyncTestCase <FNFutureInstrumentationDelegate> {
+  FNFutureChainMetrics *_metrics;
+}
 @end
 
 @implementation FNFutureTest
@@ -45,6 +51,19 @@
   GHAssertEquals(err.domain, @"fail", @"result did match expected value");
 }
 
+- (void)testWaitUntil {
+  FNMutableFuture *never = [FNMutableFuture new];
+  GHAssertFalse([never waitUntil:[NSDate dateWithTimeIntervalSinceNow:0.05]], @"wait did not time out");
+  GHAssertFalse(never.isCompleted, @"future completed unexpectedly");
+
+  FNFuture *res = [FNFuture inBackground:^{
+    usleep(10000);
+    return @"foo";
+  }];
+
+  GHAssertTrue([res waitUntil:[NSDate dateWithTimeIntervalSinceNow:1.0]], @"future did not finish before the deadline");
+}
+
 - (void)testOnCompletion {
   [self prepare];
 
@@ -115,6 +134,31 @@
   [self waitForStatus:kGHUnitWaitStatusSuccess timeout:1.0];
 }
 
+- (void)testMapOnInlineExecutor {
+  FNFuture *res = [[FNFuture value:@"foo"] map:^(NSString *value) {
+    return [value stringByAppendingString:@" bar"];
+  } on:[FNInlineExecutor sharedExecutor]];
+
+  GHAssertTrue(res.isCompleted, @"inline map did not complete synchronously");
+  GHAssertEqualObjects(res.value, @"foo bar", @"result did not match expected value");
+}
+
+- (void)testWithExecutor {
+  [self prepare];
+
+  [[[[FNFuture inBackground:^{
+    return @"foo";
+  }] withExecutor:[FNDispatchExecutor mainExecutor]] map:^(NSString *value) {
+    return @([NSThread isMainThread]);
+  }] onSuccess:^(NSNumber *isMain) {
+    if (isMain.boolValue) {
+      [self notify:kGHUnitWaitStatusSuccess forSelector:@selector(testWithExecutor)];
+    }
+  }];
+
+  [self waitForStatus:kGHUnitWaitStatusSuccess timeout:1.0];
+}
+
 - (void)testFlatMap {
   [self prepare];
 
@@ -132,6 +176,97 @@
   [self waitForStatus:kGHUnitWaitStatusSuccess timeout:1.0];
 }
 
+- (void)testConcurrentOnCompletion {
+  [self prepare];
+
+  FNMutableFuture *res = [FNMutableFuture new];
+  size_t total = 1000;
+  int32_t __block count = 0;
+
+  dispatch_apply(total, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+    if (i == total / 2) [res updateIfEmpty:@"done"];
+
+    [res onCompletion:^(FNFuture *result) {
+      if (OSAtomicIncrement32Barrier(&count) == total) {
+        [self notify:kGHUnitWaitStatusSuccess forSelector:@selector(testConcurrentOnCompletion)];
+      }
+    }];
+  });
+
+  [self waitForStatus:kGHUnitWaitStatusSuccess timeout:1.0];
+}
+
+- (void)testWorkStealingExecutorCompensatesBlockedWorkers {
+  FNWorkStealingExecutor *pool = [[FNWorkStealingExecutor alloc] initWithSize:1];
+  FNMutableFuture *inner = [FNMutableFuture new];
+  FNMutableFuture *outer = [FNMutableFuture new];
+
+  // The only worker blocks on a block queued behind it, which can only run
+  // on a compensating thread.
+  [pool execute:^{
+    [pool execute:^{ [inner update:@"inner"]; }];
+    [outer update:inner.get];
+  }];
+
+  GHAssertTrue([outer waitUntil:[NSDate dateWithTimeIntervalSinceNow:1.0]], @"blocked worker was not compensated");
+  GHAssertEqualObjects(outer.value, @"inner", @"wrong value");
+
+  [pool shutdown];
+}
+
+- (void)futureChainDidComplete:(FNFutureChainMetrics *)metrics {
+  _metrics = metrics;
+}
+
+- (void)testInstrumentation {
+  [FNFutureInstrumentation setDelegate:self];
+
+  FNMutableFuture *source = [FNMutableFuture new];
+  FNFuture *mapped = [source map:^(NSString *value) {
+    return [value stringByAppendingString:@"bar"];
+  } on:[FNInlineExecutor sharedExecutor]];
+
+  [FNFutureInstrumentation setDelegate:nil];
+
+  [mapped onCompletion:^(FNFuture *result) { } on:[FNInlineExecutor sharedExecutor]];
+  GHAssertNil(_metrics, @"chain reported before completion");
+
+  [FNFutureInstrumentation setDelegate:self];
+  [source update:@"foo"];
+  [FNFutureInstrumentation setDelegate:nil];
+
+  GHAssertEqualObjects(mapped.value, @"foobar", @"wrong value");
+  GHAssertNotNil(_metrics, @"chain was not reported");
+  GHAssertEquals(_metrics.futures, (NSUInteger)2, @"wrong future count");
+  GHAssertEquals(_metrics.callbacks, (NSUInteger)2, @"wrong callback count");
+  GHAssertEquals(_metrics.hops, (NSUInteger)0, @"inline callbacks counted as hops");
+}
+
+- (void)testSequence {
+  NSMutableArray *futures = [NSMutableArray new];
+
+  for (int i = 0; i < 100; i++) {
+    [futures addObject:i % 2 == 0 ? [FNFuture value:@(i)] : [FNFuture inBackground:^{ return @(i); }]];
+  }
+
+  NSArray *result = [FNFutureSequence(futures) get];
+
+  GHAssertEquals(result.count, (NSUInteger)100, @"sequence did not contain every result");
+  for (int i = 0; i < 100; i++) {
+    GHAssertEqualObjects(result[i], @(i), @"sequence was out of order");
+  }
+}
+
+- (void)testSequenceCollectingErrors {
+  NSError *e1 = [NSError errorWithDomain:@"fail" code:1 userInfo:@{}];
+  NSError *e2 = [NSError errorWithDomain:@"fail" code:2 userInfo:@{}];
+  FNFuture *res = FNFutureSequenceCollectingErrors(@[[FNFuture error:e1], [FNFuture value:@"ok"], [FNFuture error:e2]]);
+
+  GHAssertFalse(res.wait, @"sequence did not fail");
+  GHAssertTrue(res.error.isFNMultipleErrors, @"sequence did not collect errors");
+  GHAssertEqualObjects(res.error.userInfo[@"errors"], (@[e1, e2]), @"collected errors did not match");
+}
+
 - (void)testCancellation {
   [self prepare];
 
@@ -159,6 +294,150 @@
   [self waitForStatus:kGHUnitWaitStatusSuccess timeout:1.0];
 }
 
+- (void)testCancellationFansOut {
+  FNMutableFuture *a = [FNMutableFuture new];
+  FNMutableFuture *b = [FNMutableFuture new];
+  FNMutableFuture *inner = [FNMutableFuture new];
+
+  FNFuture *flat = [a flatMap:^(id value) { return inner; } on:[FNInlineExecutor sharedExecutor]];
+  FNFuture *seq = FNFutureSequence(@[flat, b]);
+
+  [a update:@"foo"];
+  [seq cancel];
+
+  GHAssertTrue(b.isCancelled, @"cancellation did not reach sequence input");
+  GHAssertTrue(flat.isCancelled, @"cancellation did not reach flatMap result");
+  GHAssertTrue(inner.isCancelled, @"cancellation did not reach flatMap source");
+}
+
+- (void)testFailureDoesNotCancelInputs {
+  FNMutableFuture *a = [FNMutableFuture new];
+  FNMutableFuture *b = [FNMutableFuture new];
+
+  FNFuture *seq = FNFutureSequence(@[a, b]);
+  FNFuture *join = FNFutureJoin(@[a, b]);
+
+  [a updateError:FNOperationCancelled()];
+
+  GHAssertTrue(seq.isError, @"sequence did not fail fast");
+  GHAssertTrue(join.isError, @"join did not fail fast");
+  GHAssertFalse(b.isCancelled, @"failure cancelled a pending input");
+}
+
+- (void)testWithTimeout {
+  FNMutableFuture *slow = [FNMutableFuture new];
+  FNFuture *timed = [slow withTimeout:0.05];
+
+  GHAssertFalse(timed.wait, @"future did not time out");
+  GHAssertTrue(timed.error.isFNRequestTimeout, @"wrong error");
+  GHAssertTrue(slow.isCancelled, @"timed out future was not cancelled");
+
+  FNMutableFuture *fast = [FNMutableFuture new];
+  timed = [fast withTimeout:10];
+  [fast update:@"foo"];
+
+  GHAssertEqualObjects(timed.get, @"foo", @"timeout changed the result");
+}
+
+- (void)testFirstOfAndRace {
+  FNMutableFuture *a = [FNMutableFuture new];
+  FNMutableFuture *b = [FNMutableFuture new];
+  FNMutableFuture *c = [FNMutableFuture new];
+
+  FNFuture *first = FNFutureFirstOf(@[a, b, c]);
+  FNFuture *race = FNFutureRace(@[a, b, c]);
+
+  [a updateError:FNOperationCancelled()];
+  [b update:@"b"];
+
+  GHAssertEqualObjects(first.get, @"b", @"first success did not win");
+  GHAssertTrue(race.isError, @"first completion did not win");
+  GHAssertTrue(c.isCancelled, @"loser was not cancelled");
+  GHAssertFalse(b.isCancelled, @"winner was cancelled");
+  GHAssertFalse(a.isCancelled, @"completed input was cancelled");
+
+  FNFuture *failed = FNFutureFirstOf(@[[FNFuture error:FNOperationCancelled()], [FNFuture error:FNRequestTimeout()]]);
+
+  GHAssertTrue(failed.isError, @"future did not fail");
+  GHAssertTrue(failed.error.isFNMultipleErrors, @"errors were not collected");
+}
+
+- (void)testSiblingCallbacksRunIndependently {
+  FNMutableFuture *f = [FNMutableFuture new];
+  FNMutableFuture *sibling = [FNMutableFuture new];
+  __block BOOL sawSibling = NO;
+
+  FNFuture *blocking = [f map:^(id value) {
+    sawSibling = [sibling waitUntil:[NSDate dateWithTimeIntervalSinceNow:2]];
+    return value;
+  }];
+
+  // Registered without an executor, so it is batched with the map above.
+  [f onCompletion:^(FNFuture *result) {
+    [sibling update:result.value];
+  }];
+
+  [f update:@1];
+  [blocking wait];
+
+  GHAssertTrue(sawSibling, @"a blocked callback held up its sibling");
+}
+
+- (void)testSingleFlight {
+  FNSingleFlight *flight = [FNSingleFlight new];
+  __block int started = 0;
+  __block FNMutableFuture *upstream = [FNMutableFuture new];
+
+  FNFuture *(^start)(void) = ^{
+    started++;
+    return (FNFuture *)upstream;
+  };
+
+  FNFuture *a = [flight futureForKey:@"k" start:start];
+  FNFuture *b = [flight futureForKey:@"k" start:start];
+  FNFuture *c = [flight futureForKey:@"k" start:start];
+
+  GHAssertEquals(started, 1, @"identical calls were not coalesced");
+  GHAssertEquals(flight.hits, (NSUInteger)2, @"wrong hit count");
+
+  [a cancel];
+  [b cancel];
+
+  GHAssertTrue(a.error.isFNOperationCancelled, @"cancelled caller was not failed");
+  GHAssertFalse(upstream.isCancelled, @"upstream cancelled while a caller still waits");
+
+  [c cancel];
+
+  GHAssertTrue(upstream.isCancelled, @"upstream not cancelled once every caller cancelled");
+
+  upstream = [FNMutableFuture new];
+  FNFuture *d = [flight futureForKey:@"k" start:start];
+  [upstream update:@"foo"];
+
+  GHAssertEquals(started, 2, @"cancelled operation was joined");
+  GHAssertEqualObjects(d.get, @"foo", @"wrong value");
+
+  [flight futureForKey:@"k" start:start];
+  GHAssertEquals(started, 3, @"completed operation was joined");
+}
+
+- (void)testSingleFlightStartFailure {
+  FNSingleFlight *flight = [FNSingleFlight new];
+  __block FNFuture *joined;
+
+  GHAssertThrows([flight futureForKey:@"k" start:^FNFuture *{
+    joined = [flight futureForKey:@"k" start:^{ return [FNFuture value:@"unused"]; }];
+    @throw [NSException exceptionWithName:@"TestException" reason:@"start failed" userInfo:nil];
+  }], @"start's exception was swallowed");
+
+  GHAssertTrue(joined.error.isFNOperationCancelled, @"joined caller was not failed");
+
+  GHAssertThrows([flight futureForKey:@"k" start:^FNFuture *{ return nil; }], @"nil operation was accepted");
+
+  FNFuture *fresh = [flight futureForKey:@"k" start:^{ return [FNFuture value:@"foo"]; }];
+  GHAssertEqualObjects(fresh.get, @"foo", @"failed start was joined");
+}
+
 - (void)testFutureScope {
   [self prepare];
 
@@ -178,6 +457,21 @@
   [self waitForStatus:kGHUnitWaitStatusSuccess timeout:1.0];
 }
 
+- (void)testSavedScopeIsImmutable {
+  [FNFutureScope setCurrentObject:@"before" forKey:@"val"];
+  FNFutureScope *saved = [FNFutureScope saveCurrent];
+  [FNFutureScope setCurrentObject:@"after" forKey:@"val"];
+
+  GHAssertEqualObjects(saved[@"val"], @"before", @"saved scope was modified");
+
+  [FNFutureScope inScope:saved perform:^{
+    GHAssertEqualObjects(FNFuture.currentScope[@"val"], @"before", @"saved scope was not restored");
+  }];
+
+  GHAssertEqualObjects(FNFuture.currentScope[@"val"], @"after", @"current scope was not restored");
+  [FNFutureScope setCurrentObject:nil forKey:@"val"];
+}
+
 - (void)testNeverDeadlocksOnMain {
   [self prepare];
 
@@ -18,6 +18,8 @@
 #import <GHUnitIOS/GHUnit.h>
 #import <Fauna/FNSQLiteCache.h>
 #import <Fauna/FNFuture.h>
+#import <Fauna/FNCacheCodec.h>
+#import <Fauna/FNSQLiteConnection.h>
 
 #define MaxCacheSize 1 * 1024 * 1024
 
@@ -57,6 +59,201 @@
   [self waitForStatus:kGHUnitWaitStatusSuccess timeout:1.0];
 }
 
+- (void)testBatchedWrites {
+  FNSQLiteCache *cache = [FNSQLiteCache cacheWithName:TestUniqueID() maxSize:MaxCacheSize];
+  FNTimestamp now = FNNow();
+
+  FNFuture *batch = [cache setObjects:@[@{@"ref": @"tests/a", @"test": @"a"}, @{@"ref": @"tests/b", @"test": @"b"}] timestamp:now];
+  FNFuture *single = [cache setObject:@{@"ref": @"tests/c", @"test": @"c"} extraPaths:@[@"other/c"] timestamp:now];
+
+  GHAssertTrue(batch.wait, @"batch write failed");
+  GHAssertTrue(single.wait, @"grouped write failed");
+
+  GHAssertEqualObjects([[cache objectForPath:@"tests/b" after:FNFirst] get][@"test"], @"b", @"batched object not stored");
+  GHAssertEqualObjects([[cache objectForPath:@"other/c" after:FNFirst] get][@"test"], @"c", @"grouped object not stored");
+}
+
+- (void)testMultiGet {
+  FNSQLiteCache *cache = [FNSQLiteCache cacheWithName:TestUniqueID() maxSize:MaxCacheSize];
+  FNTimestamp now = FNNow();
+
+  [cache setObjects:@[@{@"ref": @"tests/a", @"test": @"a"}, @{@"ref": @"tests/b", @"test": @"b"}] timestamp:now];
+  GHAssertTrue([[cache removeObjectForPath:@"tests/c" timestamp:now] wait], @"write failed");
+
+  NSDictionary *rv = [[cache objectsForPaths:@[@"tests/a", @"tests/b", @"tests/c", @"tests/d"] after:FNFirst] get];
+
+  GHAssertEqualObjects(rv[@"tests/a"][@"test"], @"a", @"object not read");
+  GHAssertEqualObjects(rv[@"tests/b"][@"test"], @"b", @"object not read");
+  GHAssertTrue(rv[@"tests/c"] == FNCacheTombstone, @"tombstone not read");
+  GHAssertNil(rv[@"tests/d"], @"missing path returned");
+}
+
+- (void)testMigratesVersion2Tables {
+  NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[TestUniqueID() stringByAppendingString:@".db"]];
+  FNSQLiteConnection *db = [[FNSQLiteConnection alloc] initWithSQLitePath:path];
+  NSData *data = [NSKeyedArchiver archivedDataWithRootObject:@{@"ref": @"tests/old", @"test": @"old"}];
+
+  GHAssertTrue([db execute:@"CREATE TABLE version (version INTEGER NOT NULL)" error:NULL], @"setup failed");
+  GHAssertTrue([db execute:@"INSERT INTO version (version) VALUES (2)" error:NULL], @"setup failed");
+  GHAssertTrue([db execute:@"CREATE TABLE resources (id INTEGER PRIMARY KEY NOT NULL, data BLOB, timestamp INTEGER NOT NULL, deleted INTEGER NOT NULL DEFAULT 0)" error:NULL], @"setup failed");
+  GHAssertTrue([db execute:@"CREATE TABLE resource_aliases (alias TEXT PRIMARY KEY NOT NULL, resource_id INTEGER NOT NULL, derived INTEGER NOT NULL)" error:NULL], @"setup failed");
+  GHAssertTrue([db execute:@"INSERT INTO resources (id, data, timestamp) VALUES (1, ?, ?)" parameters:@[data, FNTimestampToNSNumber(FNNow())] error:NULL], @"setup failed");
+  GHAssertTrue([db execute:@"INSERT INTO resource_aliases (alias, resource_id, derived) VALUES ('tests/old', 1, 1)" error:NULL], @"setup failed");
+  [db close];
+
+  FNSQLiteCache *cache = [[FNSQLiteCache alloc] initWithSQLitePath:path maxSize:MaxCacheSize];
+
+  GHAssertEqualObjects([[cache objectForPath:@"tests/old" after:FNFirst] get][@"test"], @"old", @"entry lost in migration");
+  GHAssertTrue([[cache setObject:@{@"ref": @"tests/new", @"test": @"new"} extraPaths:@[] timestamp:FNNow()] wait], @"write after migration failed");
+
+  [cache close];
+  [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+}
+
+- (void)testOperationsQueueBehindOpen {
+  FNSQLiteCache *cache = [FNSQLiteCache cacheWithName:TestUniqueID() maxSize:MaxCacheSize];
+
+  FNFuture *write = [cache setObject:@{@"ref": @"tests/a", @"test": @"a"} extraPaths:@[] timestamp:FNNow()];
+  FNFuture *read = [cache objectForPath:@"tests/missing" after:FNFirst];
+
+  GHAssertTrue(cache.ready.wait, @"cache failed to open");
+  GHAssertTrue(write.wait, @"write issued before open failed");
+  GHAssertTrue(read.wait, @"read issued before open failed");
+  GHAssertEqualObjects([[cache objectForPath:@"tests/a" after:FNFirst] get][@"test"], @"a", @"object not stored");
+}
+
+- (void)testCancelledReadDuringOpenLeavesCacheUsable {
+  FNSQLiteCache *cache = [FNSQLiteCache cacheWithName:TestUniqueID() maxSize:MaxCacheSize];
+
+  [[cache objectForPath:@"tests/missing" after:FNFirst] cancel];
+
+  GHAssertTrue(cache.ready.wait, @"cancelled read failed the open");
+  GHAssertTrue([[cache setObject:@{@"ref": @"tests/a", @"test": @"a"} extraPaths:@[] timestamp:FNNow()] wait], @"write failed after a cancelled read");
+}
+
+- (void)testReadyFailsWhenOpenFails {
+  NSString *path = [NSString stringWithFormat:@"/nonexistent-%@/cache.db", TestUniqueID()];
+  FNSQLiteCache *cache = [[FNSQLiteCache alloc] initWithSQLitePath:path maxSize:MaxCacheSize];
+
+  GHAssertFalse(cache.ready.wait, @"ready succeeded without a database");
+  GHAssertFalse([[cache setObject:@{@"ref": @"tests/a"} extraPaths:@[] timestamp:FNNow()] wait], @"write succeeded without a database");
+}
+
+- (void)testCodecsRoundTrip {
+  NSDictionary *dict = @{@"ref": @"tests/codec",
+                         @"data": @{@"name": @"caf\u00e9", @"tags": @[@"a", @"b", @"a"], @"none": [NSNull null]},
+                         @"count": @-42,
+                         @"ratio": @0.25,
+                         @"flag": @YES};
+
+  for (id<FNCacheCodec> codec in @[[FNKeyedArchiverCodec new], [FNBinaryCodec new], [FNJSONCodec new]]) {
+    NSData *data = [codec encode:dict];
+    GHAssertNotNil(data, @"codec %d failed to encode", codec.identifier);
+    GHAssertEqualObjects([codec decode:data], dict, @"codec %d did not round trip", codec.identifier);
+  }
+
+  GHAssertNil([[FNBinaryCodec new] decode:[@"garbage" dataUsingEncoding:NSUTF8StringEncoding]], @"malformed data decoded");
+}
+
+- (void)testReadsEntriesWrittenWithOtherCodecs {
+  FNSQLiteCache *cache = [FNSQLiteCache cacheWithName:TestUniqueID() maxSize:MaxCacheSize];
+
+  cache.codec = [FNKeyedArchiverCodec new];
+  GHAssertTrue([[cache setObject:@{@"ref": @"tests/old", @"test": @"old"} extraPaths:@[] timestamp:FNNow()] wait], @"write failed");
+
+  cache.codec = [FNBinaryCodec new];
+  GHAssertTrue([[cache setObject:@{@"ref": @"tests/new", @"test": @"new"} extraPaths:@[] timestamp:FNNow()] wait], @"write failed");
+
+  GHAssertEqualObjects([[cache objectForPath:@"tests/old" after:FNFirst] get][@"test"], @"old", @"archived entry not read");
+  GHAssertEqualObjects([[cache objectForPath:@"tests/new" after:FNFirst] get][@"test"], @"new", @"binary entry not read");
+}
+
+- (void)testEvictsLeastRecentlyUsed {
+  FNSQLiteCache *cache = [FNSQLiteCache cacheWithName:TestUniqueID() maxSize:96 * 1024];
+  NSString *body = [@"" stringByPaddingToLength:1024 withString:@"x" startingAtIndex:0];
+  FNFuture *write;
+
+  GHAssertTrue([[cache setObject:@{@"ref": @"tests/keep", @"body": body} extraPaths:@[] timestamp:FNNow()] wait], @"write failed");
+
+  for (int i = 0; i < 100; i++) {
+    if (i == 50) GHAssertNotNil([[cache objectForPath:@"tests/keep" after:FNFirst] get], @"entry evicted early");
+
+    NSString *ref = [NSString stringWithFormat:@"tests/%d", i];
+    write = [cache setObject:@{@"ref": ref, @"body": body} extraPaths:@[] timestamp:FNNow()];
+  }
+
+  GHAssertTrue(write.wait, @"write failed");
+
+  GHAssertNil([[cache objectForPath:@"tests/0" after:FNFirst] get], @"least recent entry not evicted");
+  GHAssertNotNil([[cache objectForPath:@"tests/keep" after:FNFirst] get], @"recently read entry evicted");
+  GHAssertNotNil([[cache objectForPath:@"tests/99" after:FNFirst] get], @"newest entry evicted");
+}
+
+- (void)testForwardsBusySettings {
+  NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[TestUniqueID() stringByAppendingString:@".db"]];
+  FNSQLiteCache *cache = [[FNSQLiteCache alloc] initWithSQLitePath:path maxSize:MaxCacheSize];
+
+  GHAssertEquals(cache.maxBusyRetries, (NSUInteger)8, @"wrong default");
+  cache.maxBusyRetries = 0;
+  GHAssertTrue(cache.ready.wait, @"cache failed to open");
+
+  FNSQLiteConnection *other = [[FNSQLiteConnection alloc] initWithSQLitePath:path];
+  GHAssertTrue([other execute:@"BEGIN IMMEDIATE" error:NULL], @"could not take the write lock");
+
+  GHAssertFalse([[cache setObject:@{@"ref": @"tests/a", @"test": @"a"} extraPaths:@[] timestamp:FNNow()] wait], @"write succeeded under another connection's lock");
+
+  [other execute:@"ROLLBACK" error:NULL];
+  [other close];
+
+  // Queued behind the failed flush, so its contention has been tallied.
+  GHAssertTrue([[cache setObject:@{@"ref": @"tests/a", @"test": @"a"} extraPaths:@[] timestamp:FNNow()] wait], @"write failed once the lock was released");
+  GHAssertEquals(cache.contentionCount, (NSUInteger)1, @"busy statement retried despite maxBusyRetries = 0");
+
+  [cache close];
+  [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+}
+
+- (void)testReadsOwnWrites {
+  NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[TestUniqueID() stringByAppendingString:@".db"]];
+  FNSQLiteCache *cache = [[FNSQLiteCache alloc] initWithSQLitePath:path maxSize:MaxCacheSize readers:2];
+  cache.groupCommitWindow = 5.0;
+
+  GHAssertTrue(cache.ready.wait, @"cache failed to open");
+
+  [cache setObject:@{@"ref": @"tests/a", @"test": @"a"} extraPaths:@[] timestamp:FNNow()];
+
+  FNFuture *read = [cache objectForPath:@"tests/a" after:FNFirst];
+  GHAssertTrue([read waitUntil:[NSDate dateWithTimeIntervalSinceNow:2]], @"read waited out the commit window");
+  GHAssertEqualObjects(read.value[@"test"], @"a", @"read missed a pending write");
+
+  [cache close];
+  [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+}
+
+- (void)testReadsDuringWriteTransaction {
+  NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[TestUniqueID() stringByAppendingString:@".db"]];
+  FNSQLiteCache *cache = [[FNSQLiteCache alloc] initWithSQLitePath:path maxSize:MaxCacheSize readers:2];
+
+  GHAssertTrue([[cache setObject:@{@"ref": @"tests/a", @"test": @"a"} extraPaths:@[] timestamp:FNNow()] wait], @"write failed");
+
+  FNSQLiteConnection *other = [[FNSQLiteConnection alloc] initWithSQLitePath:path];
+  GHAssertTrue([other execute:@"BEGIN IMMEDIATE" error:NULL], @"could not take the write lock");
+  GHAssertTrue([other execute:@"UPDATE resources SET deleted = 1" error:NULL], @"uncommitted write failed");
+
+  NSMutableArray *reads = [NSMutableArray new];
+  for (int i = 0; i < 8; i++) [reads addObject:[cache objectForPath:@"tests/a" after:FNFirst]];
+
+  for (FNFuture *read in reads) {
+    GHAssertTrue([read waitUntil:[NSDate dateWithTimeIntervalSinceNow:2]], @"read blocked behind a write transaction");
+    GHAssertEqualObjects(read.value[@"test"], @"a", @"read saw an uncommitted write");
+  }
+
+  [other execute:@"ROLLBACK" error:NULL];
+  [other close];
+  [cache close];
+  [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+}
+
 //- (void)testUpdateIfNewer {
 //  [self prepare];
 //  NSString *testKey = @"testKey";
@@ -0,0 +1,240 @@
+//
+// FNSQLiteConnectionTest.m
+//
+// Copyright (c) 2013 Fauna, Inc.
+//
+// Licensed under the Mozilla Public License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain a
+// copy of the License at
+//
+// http://mozilla.org/MPL/2.0/
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+//
+
+#import <GHUnitIOS/GHUnit.h>
+#import <Fauna/FNSQLiteConnection.h>
+#import <Fauna/FNError.h>
+
+static NSString * TestDatabasePath(void) {
+  return [NSTemporaryDirectory() stringByAppendingPathComponent:[TestUniqueID() stringByAppendingString:@".db"]];
+}
+
+@interface FNSQLiteConnectionTest : GHTestCase { }
+@end
+
+@implementation FNSQLiteConnectionTest
+
+- (void)testStatementCacheHits {
+  NSString *path = TestDatabasePath();
+  FNSQLiteConnection *db = [[FNSQLiteConnection alloc] initWithSQLitePath:path];
+
+  GHAssertEquals(db.statementCacheSize, (NSUInteger)32, @"wrong default cache size");
+
+  NSUInteger hits = db.statementCacheHits, misses = db.statementCacheMisses;
+
+  GHAssertNotNil([db select:@"SELECT 1" error:NULL], @"select failed");
+  GHAssertNotNil([db select:@"SELECT 1" error:NULL], @"select failed");
+
+  GHAssertEquals(db.statementCacheMisses - misses, (NSUInteger)1, @"statement prepared more than once");
+  GHAssertEquals(db.statementCacheHits - hits, (NSUInteger)1, @"cached statement not reused");
+
+  [db close];
+  [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+}
+
+- (void)testStatementCacheEvictsLeastRecentlyUsed {
+  NSString *path = TestDatabasePath();
+  FNSQLiteConnection *db = [[FNSQLiteConnection alloc] initWithSQLitePath:path];
+
+  // Fill the default-sized cache, then touch the oldest so the second
+  // oldest is the one evicted.
+  for (int i = 0; i < 32; i++) {
+    [db select:[NSString stringWithFormat:@"SELECT %d", i] error:NULL];
+  }
+  [db select:@"SELECT 0" error:NULL];
+  [db select:@"SELECT 32" error:NULL];
+
+  NSUInteger misses = db.statementCacheMisses;
+
+  [db select:@"SELECT 0" error:NULL];
+  GHAssertEquals(db.statementCacheMisses, misses, @"recently used statement evicted");
+
+  [db select:@"SELECT 1" error:NULL];
+  GHAssertEquals(db.statementCacheMisses, misses + 1, @"least recently used statement kept");
+
+  db.statementCacheSize = 0;
+  misses = db.statementCacheMisses;
+
+  [db select:@"SELECT 0" error:NULL];
+  [db select:@"SELECT 0" error:NULL];
+  GHAssertEquals(db.statementCacheMisses, misses + 2, @"statements cached with the cache disabled");
+
+  [db close];
+  [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+}
+
+- (void)testRegisteredStatementsAreNotEvicted {
+  NSString *path = TestDatabasePath();
+  FNSQLiteConnection *db = [[FNSQLiteConnection alloc] initWithSQLitePath:path];
+
+  db.statementCacheSize = 1;
+
+  GHAssertTrue([db registerStatement:@"SELECT 0" error:NULL], @"registration failed");
+  GHAssertFalse([db registerStatement:@"SELECT FROM" error:NULL], @"invalid statement registered");
+
+  [db select:@"SELECT 1" error:NULL];
+  [db select:@"SELECT 2" error:NULL];
+
+  NSUInteger misses = db.statementCacheMisses;
+
+  [db select:@"SELECT 0" error:NULL];
+  GHAssertEquals(db.statementCacheMisses, misses, @"registered statement evicted");
+
+  [db select:@"SELECT 2" error:NULL];
+  GHAssertEquals(db.statementCacheMisses, misses, @"registered statement counted against the cache size");
+
+  [db close];
+  [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+}
+
+- (void)testHeldWriteLockFailsWithDatabaseBusy {
+  NSString *path = TestDatabasePath();
+  FNSQLiteConnection *holder = [[FNSQLiteConnection alloc] initWithSQLitePath:path];
+  FNSQLiteConnection *db = [[FNSQLiteConnection alloc] initWithSQLitePath:path];
+  NSError __autoreleasing *err;
+
+  GHAssertTrue([holder execute:@"CREATE TABLE t (x INTEGER)" error:NULL], @"setup failed");
+  GHAssertTrue([holder execute:@"BEGIN IMMEDIATE" error:NULL], @"could not take the write lock");
+
+  db.maxBusyRetries = 2;
+  NSUInteger contention = db.contentionCount;
+
+  GHAssertFalse([db execute:@"INSERT INTO t (x) VALUES (1)" error:&err], @"write succeeded under another connection's lock");
+  GHAssertTrue(err.isFNDatabaseBusy, @"wrong error: %@", err);
+  GHAssertEquals(db.contentionCount - contention, (NSUInteger)3, @"statement not retried maxBusyRetries times");
+
+  GHAssertTrue([holder execute:@"COMMIT" error:NULL], @"commit failed");
+  GHAssertTrue([db execute:@"INSERT INTO t (x) VALUES (1)" error:NULL], @"write failed once the lock was released");
+
+  [holder close];
+  [db close];
+  [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+}
+
+- (void)testCursorStepsThroughRows {
+  NSString *path = TestDatabasePath();
+  FNSQLiteConnection *db = [[FNSQLiteConnection alloc] initWithSQLitePath:path];
+
+  GHAssertTrue([db execute:@"CREATE TABLE t (x INTEGER)" error:NULL], @"setup failed");
+  for (int i = 0; i < 3; i++) {
+    GHAssertTrue([db execute:@"INSERT INTO t (x) VALUES (?)" parameters:@[@(i)] error:NULL], @"setup failed");
+  }
+
+  FNSQLiteCursor *cursor = [db query:@"SELECT x FROM t ORDER BY x" parameters:@[] error:NULL];
+  GHAssertNotNil(cursor, @"query failed");
+  GHAssertEquals(cursor.columnCount, 1, @"wrong column count");
+
+  int64_t expected = 0;
+  while ([cursor next]) {
+    GHAssertEquals([cursor int64At:0], expected++, @"rows out of order");
+  }
+
+  GHAssertEquals(expected, (int64_t)3, @"wrong number of rows");
+  GHAssertNil(cursor.error, @"error at the end of the rows");
+  GHAssertFalse([cursor next], @"stepped past the end");
+
+  NSError __autoreleasing *err;
+  GHAssertNil([db query:@"SELECT FROM" parameters:@[] error:&err], @"invalid query returned a cursor");
+  GHAssertNotNil(err, @"no error for an invalid query");
+
+  [db close];
+  [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+}
+
+- (void)testCursorTypedAccessors {
+  NSString *path = TestDatabasePath();
+  FNSQLiteConnection *db = [[FNSQLiteConnection alloc] initWithSQLitePath:path];
+  NSData *blob = [@"blob" dataUsingEncoding:NSUTF8StringEncoding];
+
+  FNSQLiteCursor *cursor = [db query:@"SELECT ?, ?, ?, ?, NULL" parameters:@[@42, @0.5, @"caf\u00e9", blob] error:NULL];
+  GHAssertTrue([cursor next], @"no row");
+
+  GHAssertEquals([cursor int64At:0], (int64_t)42, @"wrong integer");
+  GHAssertEquals([cursor doubleAt:1], 0.5, @"wrong double");
+  GHAssertEqualObjects([cursor textAt:2], @"caf\u00e9", @"wrong text");
+  GHAssertEqualObjects([cursor blobNoCopyAt:3], blob, @"wrong blob");
+
+  GHAssertEqualObjects([cursor objectAt:0], @42, @"wrong boxed integer");
+  GHAssertEqualObjects([cursor objectAt:1], @0.5, @"wrong boxed double");
+  GHAssertEqualObjects([cursor objectAt:2], @"caf\u00e9", @"wrong boxed text");
+  GHAssertEqualObjects([cursor objectAt:3], blob, @"wrong boxed blob");
+
+  GHAssertFalse([cursor isNullAt:0], @"integer read as NULL");
+  GHAssertTrue([cursor isNullAt:4], @"NULL not read as NULL");
+  GHAssertEquals([cursor int64At:4], (int64_t)0, @"NULL not read as 0");
+  GHAssertNil([cursor textAt:4], @"NULL read as text");
+  GHAssertNil([cursor blobNoCopyAt:4], @"NULL read as a blob");
+  GHAssertNil([cursor objectAt:4], @"NULL boxed");
+
+  GHAssertFalse([cursor next], @"more than one row");
+
+  [db close];
+  [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+}
+
+- (void)testClosingCursorEarlyReleasesStatement {
+  NSString *path = TestDatabasePath();
+  FNSQLiteConnection *db = [[FNSQLiteConnection alloc] initWithSQLitePath:path];
+
+  GHAssertTrue([db execute:@"CREATE TABLE t (x INTEGER)" error:NULL], @"setup failed");
+  GHAssertTrue([db execute:@"INSERT INTO t (x) VALUES (1), (2), (3)" error:NULL], @"setup failed");
+
+  FNSQLiteCursor *cursor = [db query:@"SELECT x FROM t" parameters:@[] error:NULL];
+  GHAssertTrue([cursor next], @"no row");
+  [cursor close];
+
+  GHAssertFalse([cursor next], @"closed cursor stepped");
+
+  // A cursor dropped mid-read releases its statement as it is deallocated.
+  @autoreleasepool {
+    FNSQLiteCursor *dropped = [db query:@"SELECT x FROM t ORDER BY x DESC" parameters:@[] error:NULL];
+    GHAssertTrue([dropped next], @"no row");
+  }
+
+  // Fails with SQLITE_LOCKED while either statement is still mid-read.
+  GHAssertTrue([db execute:@"DROP TABLE t" error:NULL], @"statement left active after its cursor closed");
+
+  [db close];
+  [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+}
+
+- (void)testCachedStatementResetsAfterPartialRead {
+  NSString *path = TestDatabasePath();
+  FNSQLiteConnection *db = [[FNSQLiteConnection alloc] initWithSQLitePath:path];
+  NSString *sql = @"SELECT x FROM t WHERE x > ? ORDER BY x";
+
+  GHAssertTrue([db execute:@"CREATE TABLE t (x INTEGER)" error:NULL], @"setup failed");
+  GHAssertTrue([db execute:@"INSERT INTO t (x) VALUES (1), (2), (3)" error:NULL], @"setup failed");
+
+  FNSQLiteCursor *cursor = [db query:sql parameters:@[@0] error:NULL];
+  GHAssertTrue([cursor next], @"no row");
+  GHAssertTrue([cursor next], @"no second row");
+  [cursor close];
+
+  NSUInteger hits = db.statementCacheHits;
+
+  cursor = [db query:sql parameters:@[@1] error:NULL];
+  GHAssertEquals(db.statementCacheHits, hits + 1, @"statement not reused");
+  GHAssertTrue([cursor next], @"no row after reuse");
+  GHAssertEquals([cursor int64At:0], (int64_t)2, @"reused statement resumed the earlier read or kept its bindings");
+  [cursor close];
+
+  [db close];
+  [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+}
+
+@end
@@ -0,0 +1,89 @@
+//
+// FNTieredCacheTest.m
+//
+// Copyright (c) 2013 Fauna, Inc.
+//
+// Licensed under the Mozilla Public License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain a
+// copy of the License at
+//
+// http://mozilla.org/MPL/2.0/
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+//
+
+#import <GHUnitIOS/GHUnit.h>
+#import <Fauna/FNTieredCache.h>
+#import <Fauna/FNSQLiteCache.h>
+#import <Fauna/FNNullCache.h>
+#import <Fauna/FNFuture.h>
+
+@interface FNTieredCacheTest : GHTestCase { }
+@end
+
+@implementation FNTieredCacheTest
+
+- (void)testHitsCompleteSynchronously {
+  FNSQLiteCache *disk = [FNSQLiteCache cacheWithName:TestUniqueID() maxSize:1024 * 1024];
+  FNTieredCache *cache = [[FNTieredCache alloc] initWithBackingCache:disk maxSize:64 * 1024];
+
+  FNFuture *write = [cache setObject:@{@"ref": @"tests/a", @"class": @"classes/tests", @"unique_id": @"a", @"test": @"a"} extraPaths:@[@"other/a"] timestamp:FNNow()];
+
+  for (NSString *path in @[@"tests/a", @"other/a", @"classes/tests/a"]) {
+    FNFuture *rv = [cache objectForPath:path after:FNFirst];
+    GHAssertTrue(rv.isCompleted, @"hit on %@ was not synchronous", path);
+    GHAssertEqualObjects([rv get][@"test"], @"a", @"wrong value for %@", path);
+  }
+
+  GHAssertTrue(write.wait, @"write failed");
+
+  [cache removeAllMemoryObjects];
+  GHAssertEqualObjects([[cache objectForPath:@"other/a" after:FNFirst] get][@"test"], @"a", @"miss not read from disk");
+  GHAssertTrue([cache objectForPath:@"tests/a" after:FNFirst].isCompleted, @"miss did not fill memory");
+}
+
+- (void)testTombstonesAndTimestamps {
+  FNTieredCache *cache = [[FNTieredCache alloc] initWithBackingCache:[FNNullCache new] maxSize:64 * 1024];
+  FNTimestamp now = FNNow();
+
+  [cache setObject:@{@"ref": @"tests/a", @"test": @"a"} extraPaths:@[] timestamp:now];
+
+  GHAssertNil([[cache objectForPath:@"tests/a" after:now + 1] get], @"stale entry returned");
+
+  [cache removeObjectForPath:@"tests/a" timestamp:now];
+
+  FNFuture *rv = [cache objectForPath:@"tests/a" after:FNFirst];
+  GHAssertTrue(rv.isCompleted, @"tombstone was not held in memory");
+  GHAssertTrue([rv get] == FNCacheTombstone, @"removed entry returned");
+}
+
+- (void)testHeldValuesAreImmutable {
+  FNTieredCache *cache = [[FNTieredCache alloc] initWithBackingCache:[FNNullCache new] maxSize:64 * 1024];
+  NSMutableArray *tags = [NSMutableArray arrayWithObject:@"a"];
+
+  [cache setObject:@{@"ref": @"tests/a", @"tags": tags} extraPaths:@[] timestamp:FNNow()];
+  [tags addObject:@"b"];
+
+  NSArray *held = [[cache objectForPath:@"tests/a" after:FNFirst] get][@"tags"];
+  GHAssertEqualObjects(held, @[@"a"], @"caller's change reached the held value");
+  GHAssertFalse([held isKindOfClass:[NSMutableArray class]], @"held value is mutable");
+}
+
+- (void)testEvictsLeastRecentlyUsed {
+  FNTieredCache *cache = [[FNTieredCache alloc] initWithBackingCache:[FNNullCache new] maxSize:1024];
+  NSString *body = [@"" stringByPaddingToLength:100 withString:@"x" startingAtIndex:0];
+
+  [cache setObject:@{@"ref": @"tests/a", @"body": body} extraPaths:@[] timestamp:FNNow()];
+  [cache setObject:@{@"ref": @"tests/b", @"body": body} extraPaths:@[] timestamp:FNNow()];
+  [cache objectForPath:@"tests/a" after:FNFirst];
+  [cache setObject:@{@"ref": @"tests/c", @"body": body} extraPaths:@[] timestamp:FNNow()];
+
+  GHAssertNotNil([[cache objectForPath:@"tests/a" after:FNFirst] get], @"recently read entry evicted");
+  GHAssertNil([[cache objectForPath:@"tests/b" after:FNFirst] get], @"least recent entry kept");
+  GHAssertNotNil([[cache objectForPath:@"tests/c" after:FNFirst] get], @"newest entry evicted");
+}
+
+@end